@@ -6,14 +6,20 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <functional>
+#include <cwchar>
 
 namespace cmdp
 {
 
 namespace comparator {
-	struct compare_no_case : public std::binary_function<std::wstring, std::wstring, bool> {
+	struct compare_no_case {
 		bool operator()(const std::wstring& lhs, const std::wstring& rhs) const {
+			#ifdef _WIN32
 			return _wcsicmp(lhs.c_str(), rhs.c_str()) < 0;
+#else
+			return wcscasecmp(lhs.c_str(), rhs.c_str()) < 0;
+#endif
 		}
 	};
 }
@@ -53,7 +59,7 @@ public:
 
 private:
 	void parse_one_param(const wchar_t* const param, std::wstring& prev_param_name);
-	inline std::wistringstream parser::bad_stream() const;
+	inline std::wistringstream bad_stream() const;
 
 private:
 	params_map m_params;
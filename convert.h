@@ -1,7 +1,9 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include <codecvt>
+#include <locale>
 
 namespace utils {
 
@@ -39,6 +41,7 @@ static inline std::string to_utf8(const wchar_t* str)
 	return converter.to_bytes(str);
 }
 
+#ifdef _WIN32
 static inline std::string win32_error_to_ansi(DWORD errorCode)
 {
 	LPSTR messageBuffer = nullptr;
@@ -57,5 +60,6 @@ static inline std::string win32_error_to_ansi(DWORD errorCode)
 
 	return message;
 }
+#endif
 
 } // end of namespace utils
\ No newline at end of file
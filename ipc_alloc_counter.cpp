@@ -0,0 +1,159 @@
+#include "ipc_alloc_counter.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Every form of global new/delete is replaced (aligned ones are used by cache line aligned types).
+// They are in own translation unit (without spdlog and std containers), so they are not inlined into callers
+// (compiler would match inlined free() against operator new of caller).
+static std::atomic<uint64_t> g_heap_allocations = 0;
+
+static void* allocate(size_t size)
+{
+	g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	return ::malloc(size ? size : 1);
+}
+
+static void* allocate_aligned(size_t size, std::align_val_t alignment)
+{
+	g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+	return ::_aligned_malloc(size ? size : 1, static_cast<size_t>(alignment));
+#else
+	void* block = nullptr;
+	size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+	return ::posix_memalign(&block, align, size ? size : 1) == 0 ? block : nullptr;
+#endif
+}
+
+static void release_aligned(void* block)
+{
+#ifdef _WIN32
+	::_aligned_free(block);
+#else
+	::free(block);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	if(void* block = allocate(size)) {
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if(void* block = allocate(size)) {
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if(void* block = allocate_aligned(size, alignment)) {
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	if(void* block = allocate_aligned(size, alignment)) {
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocate_aligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* block) noexcept
+{
+	::free(block);
+}
+
+void operator delete[](void* block) noexcept
+{
+	::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+	::free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept
+{
+	::free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept
+{
+	::free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept
+{
+	::free(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept
+{
+	release_aligned(block);
+}
+
+void operator delete[](void* block, std::align_val_t) noexcept
+{
+	release_aligned(block);
+}
+
+void operator delete(void* block, size_t, std::align_val_t) noexcept
+{
+	release_aligned(block);
+}
+
+void operator delete[](void* block, size_t, std::align_val_t) noexcept
+{
+	release_aligned(block);
+}
+
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	release_aligned(block);
+}
+
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	release_aligned(block);
+}
+
+uint64_t heap_allocations()
+{
+	return g_heap_allocations.load();
+}
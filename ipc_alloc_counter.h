@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+//////////////////////////////////////////////////////////////////////////
+// Counting allocator, executable linking ipc_alloc_counter.cpp has global new/delete replaced by it
+
+// Heap allocations made so far (all threads)
+uint64_t heap_allocations();
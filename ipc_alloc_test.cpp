@@ -0,0 +1,97 @@
+// ipc_alloc_test.cpp : Send/response cycle must not touch heap once pools are warm.
+// Global new/delete of this executable are replaced by counting ones (ipc_alloc_counter.cpp), master and slave
+// run in this process (slave on thread), so allocations of both sides are counted. It run over pipe transport
+// (pipe pair, buffered reader, credit messages) and over loopback one.
+// Usage: ipc_alloc_test [round trips]
+
+#include "stdafx.h"
+#include "ipc_alloc_counter.h"
+#include "ipc_master.h"
+#include "ipc_slave.h"
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+// Round trips before measurement (pools are filled), measured ones (default)
+constexpr uint32_t warm_up_count = 1000;
+constexpr size_t warm_up_depth = 16;  // Requests in flight in pipelined part of warm-up
+constexpr uint32_t default_round_trip_count = 1000000;
+constexpr size_t message_size = 1024;
+
+// Run round trips over transport, false when any failed or allocated
+static bool run(ipc::transport_type type, const char* name, uint32_t round_trip_count, const ipc::logger_ptr& logger)
+{
+	ipc::master::factory master_factory;
+	std::shared_ptr<ipc::master_intf> master_ptr = master_factory.create_master(logger, [](const std::vector<uint8_t>&, std::vector<uint8_t>&) {
+	}, type);
+
+	// Echo slave on our thread (pipe pair or loopback channel of master), it serve until master disconnect
+	std::thread slave_thread([logger, connection = master_ptr->take_slave_connection()]() mutable {
+		ipc::slave::factory slave_factory;
+		std::shared_ptr<ipc::slave_intf> slave_ptr = slave_factory.create_slave(logger, connection, [](const std::vector<uint8_t>& message, std::vector<uint8_t>& response) {
+			response.assign(message.begin(), message.end());
+		});
+		slave_ptr->wait();
+		slave_ptr->stop();
+	});
+	master_ptr->start();
+
+	std::vector<uint8_t> message(message_size, 'x');
+	std::vector<uint8_t> response;
+	uint32_t failed = 0;
+	{
+		// Pipelined warm-up fill pools with more buffers than one round trip in flight ever take
+		// (sequential one may miss rare interleaving of both sides, when one more buffer is held)
+		std::vector<ipc::async_response> in_flight(warm_up_depth);
+		for(uint32_t i = 0; i < warm_up_count; i++) {
+			ipc::async_response& slot = in_flight[i % in_flight.size()];
+			if(slot.valid() && !slot.get(response)) {
+				failed++;
+			}
+			slot = master_ptr->send_async(message);
+		}
+		for(ipc::async_response& pending_response : in_flight) {
+			if(pending_response.valid() && !pending_response.get(response)) {
+				failed++;
+			}
+		}
+	}
+	for(uint32_t i = 0; i < warm_up_count; i++) {
+		if(!master_ptr->send(message, response)) {
+			failed++;
+		}
+	}
+
+	uint64_t allocations = heap_allocations();
+	for(uint32_t i = 0; i < round_trip_count; i++) {
+		if(!master_ptr->send(message, response) || response != message) {
+			failed++;
+		}
+	}
+	allocations = heap_allocations() - allocations;
+
+	master_ptr->stop();
+	slave_thread.join();
+
+	logger->info("Transport:{}, round trips:{:d}, failed:{:d}, heap allocations:{:d}", name, round_trip_count, failed, allocations);
+	if(failed || allocations) {
+		logger->error("Send/response cycle must not fail nor allocate after warm-up");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	auto logger = spdlog::stdout_color_mt("alloc_test");
+
+	uint32_t round_trip_count = default_round_trip_count;
+	if(argc > 1) {
+		round_trip_count = static_cast<uint32_t>(::strtoul(argv[1], nullptr, 10));
+	}
+
+	bool success = run(ipc::transport_type::pipe, "pipe", round_trip_count, logger);
+	success = run(ipc::transport_type::loopback, "loopback", round_trip_count, logger) && success;
+	return success ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+#include "stdafx.h"
+#include "ipc_bench.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+// Round trips before measurement (pools are filled)
+constexpr uint32_t warm_up_count = 1000;
+
+static void log_pools(ipc::master_intf& master, ipc::logger_ptr logger)
+{
+	ipc::platform::wait_pool::statistics stats = ipc::platform::wait_pool::global().stats();
+	logger->info("Wait pool hits:{:d}, misses:{:d}, cached:{:d}", stats.hits, stats.misses, stats.cached);
+	ipc::buffer_pool::statistics buffers = master.buffer_pool_stats();
+	logger->info("Buffer pool hits:{:d}, misses:{:d}, cached:{:d} B", buffers.hits, buffers.misses, buffers.cached_bytes);
+}
+
+void ping_pong(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	uint32_t threads = opt.threads ? opt.threads : 1;
+	uint32_t per_thread = opt.count / threads;
+	uint32_t count = per_thread * threads;
+
+	logger->info("Ping-pong benchmark, count:{:d}, size:{:d}, threads:{:d}, parts:{:d}", count, opt.size, threads, opt.parts);
+
+	std::atomic<uint32_t> failed = 0;
+	auto sender = [&]() {
+		std::vector<uint8_t> message(opt.size, 'x');
+		std::vector<uint8_t> response;
+
+		// Gather list over the message (parts API), last part take the rest
+		std::vector<ipc::message_view> parts;
+		ipc::message_view whole = ipc::to_view(message);
+		for(uint32_t i = 0; i < opt.parts; i++) {
+			size_t part_size = whole.size() / opt.parts;
+			size_t offset = i * part_size;
+			parts.push_back(whole.subspan(offset, (i + 1 == opt.parts) ? whole.size() - offset : part_size));
+		}
+
+		for(uint32_t i = 0; i < per_thread; i++) {
+			bool sent = parts.empty() ? master.send(message, response) : master.send(ipc::message_parts(parts), response);
+			if(!sent || response.size() != message.size()) {
+				failed++;
+			}
+		}
+	};
+
+	std::vector<uint8_t> warm_up_message(opt.size, 'x');
+	std::vector<uint8_t> warm_up_response;
+	for(uint32_t i = 0; i < warm_up_count; i++) {
+		master.send(warm_up_message, warm_up_response);
+	}
+
+	std::vector<std::thread> senders;
+	senders.reserve(threads);
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < threads; i++) {
+		senders.emplace_back(sender);
+	}
+	for(auto& thread : senders) {
+		thread.join();
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	logger->info("Ping-pong done in {:.3f}s, {:.0f} msg/s, {:.2f} us/round trip, {:.1f} MB/s, failed:{:d}"
+		, elapsed
+		, count / elapsed
+		, elapsed * 1000000.0 / count
+		, 2.0 * count * opt.size / elapsed / (1024 * 1024)
+		, failed.load());
+	log_pools(master, logger);
+}
+
+void one_way(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	std::vector<uint8_t> message(opt.size, 'x');
+
+	logger->info("One-way benchmark, count:{:d}, size:{:d}", opt.count, opt.size);
+
+	std::vector<uint8_t> response;
+	for(uint32_t i = 0; i < warm_up_count; i++) {
+		master.post(message);
+	}
+	master.send(message, response);
+
+	uint32_t failed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < opt.count; i++) {
+		if(!master.post(message)) {
+			failed++;
+		}
+	}
+	// Messages are handled in order, so response of this one mean all are done
+	if(!master.send(message, response)) {
+		failed++;
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	logger->info("One-way done in {:.3f}s, {:.0f} msg/s, {:.1f} MB/s, failed:{:d}"
+		, elapsed
+		, opt.count / elapsed
+		, 1.0 * opt.count * opt.size / elapsed / (1024 * 1024)
+		, failed);
+	log_pools(master, logger);
+}
+
+void pipeline(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	std::vector<uint8_t> message(opt.size, 'x');
+	std::vector<ipc::async_response> in_flight(opt.depth ? opt.depth : 1);
+
+	logger->info("Pipeline benchmark, count:{:d}, size:{:d}, depth:{:d}", opt.count, opt.size, in_flight.size());
+
+	uint32_t failed = 0;
+	std::vector<uint8_t> response;  // Reused, its previous buffer go back to pool
+	auto collect = [&](ipc::async_response& pending_response) {
+		if(pending_response.valid() && (!pending_response.get(response) || response.size() != message.size())) {
+			failed++;
+		}
+	};
+
+	auto run = [&](uint32_t count) {
+		for(uint32_t i = 0; i < count; i++) {
+			// Sliding window, wait for the oldest request before we send a new one
+			ipc::async_response& slot = in_flight[i % in_flight.size()];
+			collect(slot);
+			slot = master.send_async(message);
+		}
+		for(auto& pending_response : in_flight) {
+			collect(pending_response);
+			pending_response = ipc::async_response();
+		}
+	};
+
+	run(warm_up_count);
+	failed = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	run(opt.count);
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	logger->info("Pipeline done in {:.3f}s, {:.0f} msg/s, {:.1f} MB/s, failed:{:d}"
+		, elapsed
+		, opt.count / elapsed
+		, 2.0 * opt.count * opt.size / elapsed / (1024 * 1024)
+		, failed);
+	log_pools(master, logger);
+}
+
+void sweep(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	constexpr uint64_t min_size = 64 * 1024;
+	constexpr uint64_t bytes_per_size = 1024 * 1024 * 1024;  // Round trips of each size move about this much
+
+	logger->info("Sweep benchmark, size:{:d}-{:d}", min_size, opt.size);
+
+	std::vector<uint8_t> response;
+	for(uint64_t size = min_size; size <= opt.size; size *= 4) {
+		std::vector<uint8_t> message(size, 'x');
+		uint32_t count = static_cast<uint32_t>(std::clamp<uint64_t>(bytes_per_size / size, 4, opt.count));
+
+		// One round trip warm up (buffers of this size)
+		master.send(message, response);
+
+		uint32_t failed = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(uint32_t i = 0; i < count; i++) {
+			if(!master.send(message, response) || response.size() != message.size()) {
+				failed++;
+			}
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		logger->info("Size:{:d} KB, count:{:d}, {:.2f} ms/round trip, {:.1f} MB/s, failed:{:d}"
+			, size / 1024
+			, count
+			, elapsed * 1000.0 / count
+			, 2.0 * count * size / elapsed / (1024 * 1024)
+			, failed);
+	}
+}
+
+void stream(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	uint64_t total = uint64_t(opt.count) * opt.size;
+	logger->info("Stream benchmark, count:{:d}, size:{:d}, total:{:d} MB", opt.count, opt.size, total / (1024 * 1024));
+
+	auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<ipc::stream_writer> writer = master.open_stream(ipc::message_view());
+	if(!writer) {
+		logger->error("Open stream fail");
+		return;
+	}
+
+	// Write from other thread, we read echo meanwhile (writer wait when slave is behind)
+	bool written = false;
+	std::thread sender([&]() {
+		std::vector<uint8_t> chunk(opt.size, 'x');
+		written = true;
+		for(uint32_t i = 0; i < opt.count && written; i++) {
+			written = writer->write(chunk);
+		}
+		written = written && writer->close();
+	});
+
+	uint64_t received = 0;
+	bool succeeded = false;
+	if(std::shared_ptr<ipc::stream_reader> echo = master.accept_stream()) {
+		std::vector<uint8_t> chunk;
+		while(echo->read(chunk)) {
+			received += chunk.size();
+		}
+		succeeded = echo->succeeded();
+	}
+	sender.join();
+	writer.reset();
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	logger->info("Stream done in {:.3f}s, {:.1f} MB/s, received:{:d} MB, failed:{:d}"
+		, elapsed
+		, 2.0 * received / elapsed / (1024 * 1024)
+		, received / (1024 * 1024)
+		, (written && succeeded && received == total) ? 0 : 1);
+	log_pools(master, logger);
+}
+
+void streamed(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger)
+{
+	std::vector<uint8_t> message(opt.size, 'x');
+
+	logger->info("Streamed benchmark, count:{:d}, size:{:d}", opt.count, opt.size);
+
+	uint32_t failed = 0;
+	uint64_t parts = 0;
+	uint64_t bytes = 0;
+	double first_part = 0;
+	auto run = [&](uint32_t count) {
+		for(uint32_t i = 0; i < count; i++) {
+			auto sent = std::chrono::steady_clock::now();
+			std::shared_ptr<ipc::stream_reader> reader = master.send_streamed(message);
+			if(!reader) {
+				failed++;
+				continue;
+			}
+			bool first = true;
+			for(const std::vector<uint8_t>& part : *reader) {
+				if(first) {
+					first_part += std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count();
+					first = false;
+				}
+				parts++;
+				bytes += part.size();
+			}
+			if(!reader->succeeded()) {
+				failed++;
+			}
+		}
+	};
+
+	run(warm_up_count);
+	failed = 0;
+	parts = 0;
+	bytes = 0;
+	first_part = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	run(opt.count);
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	logger->info("Streamed done in {:.3f}s, {:.0f} requests/s, {:.2f} us to first part, {:.2f} us to end, {:.1f} parts/request, {:.1f} MB/s, failed:{:d}"
+		, elapsed
+		, opt.count / elapsed
+		, first_part * 1000000.0 / opt.count
+		, elapsed * 1000000.0 / opt.count
+		, 1.0 * parts / opt.count
+		, 1.0 * bytes / elapsed / (1024 * 1024)
+		, failed);
+}
+
+} // end of namespace bench
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "ipc_master_intf.h"
+#include "logger_holder.h"
+
+namespace bench {
+
+struct options {
+	uint32_t count = 100000;  // Number of round trips
+	uint32_t size = 64;       // Message size in bytes
+	uint32_t threads = 1;     // Number of sending threads (count is split between them)
+	uint32_t depth = 0;       // Requests in flight from one thread (send_async pipeline), 0 = synchronous send
+	bool one_way = false;     // Use post (no response)
+	uint32_t parts = 0;       // Send message as gather list of N parts (span API), 0 = vector API
+};
+
+// Send message and wait for response (slave echo it back), report messages/sec
+void ping_pong(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+// Post messages (one-way), one final send wait until slave handle all of them, report messages/sec
+void one_way(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+// One thread keep opt.depth requests in flight (send_async), report messages/sec
+void pipeline(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+// Ping-pong with payload from 64 KB up to opt.size (x4 each step), report MB/s for each size
+// (compare plain pipe I/O with bulk transfer or blobs)
+void sweep(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+// Stream opt.count chunks of opt.size bytes to slave, slave stream them back, report MB/s
+// (memory stay bounded by stream windows whatever total size is)
+void stream(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+// Streamed requests (send_streamed), slave answer by partial responses, report time to first part and to end
+void streamed(ipc::master_intf& master, const options& opt, ipc::logger_ptr logger);
+
+} // end of namespace bench
@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include "ipc_buffer_pool.h"
+#include <algorithm>
+#include <new>
+
+namespace ipc {
+
+buffer_pool::buffer_pool(size_t max_cached_per_class, size_t max_cached_class_bytes)
+{
+	// Free lists never grow later (release must not allocate)
+	for(size_t i = 0; i < class_count; i++) {
+		size_class& item = m_classes[i];
+		item.max_cached = std::max<size_t>(std::min(max_cached_per_class, max_cached_class_bytes / class_size(i)), 1);
+		item.buffers.reserve(item.max_cached);
+		item.blocks.reserve(item.max_cached);
+	}
+}
+
+buffer_pool::~buffer_pool()
+{
+	for(size_class& item : m_classes) {
+		for(void* block : item.blocks) {
+			::operator delete(block);
+		}
+	}
+}
+
+size_t buffer_pool::class_for_size(size_t size)
+{
+	for(size_t i = 0; i < class_count; i++) {
+		if(size <= class_size(i)) {
+			return i;
+		}
+	}
+	return class_count;
+}
+
+size_t buffer_pool::class_for_capacity(size_t capacity)
+{
+	if(capacity < class_size(0) || capacity > class_size(class_count - 1) * 2) {
+		return class_count;
+	}
+	size_t index = 0;
+	while(index + 1 < class_count && class_size(index + 1) <= capacity) {
+		index++;
+	}
+	return index;
+}
+
+std::vector<uint8_t> buffer_pool::acquire(size_t capacity)
+{
+	std::vector<uint8_t> buffer;
+	size_t index = class_for_size(capacity);
+	if(index < class_count) {
+		size_class& item = m_classes[index];
+		std::lock_guard<std::mutex> guard(item.lock);
+		if(!item.buffers.empty()) {
+			buffer.swap(item.buffers.back());
+			item.buffers.pop_back();
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return buffer;
+		}
+	}
+
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	buffer.reserve(index < class_count ? class_size(index) : capacity);
+	return buffer;
+}
+
+void buffer_pool::release(std::vector<uint8_t>& buffer)
+{
+	size_t index = class_for_capacity(buffer.capacity());
+	if(index < class_count) {
+		size_class& item = m_classes[index];
+		std::lock_guard<std::mutex> guard(item.lock);
+		if(item.buffers.size() < item.max_cached) {
+			buffer.clear();
+			item.buffers.emplace_back(std::move(buffer));
+			return;
+		}
+	}
+	std::vector<uint8_t>().swap(buffer);
+}
+
+void* buffer_pool::allocate(size_t size)
+{
+	size_t index = class_for_size(size);
+	if(index < class_count) {
+		size_class& item = m_classes[index];
+		std::lock_guard<std::mutex> guard(item.lock);
+		if(!item.blocks.empty()) {
+			void* block = item.blocks.back();
+			item.blocks.pop_back();
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return block;
+		}
+	}
+
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	return ::operator new(index < class_count ? class_size(index) : size);
+}
+
+void buffer_pool::deallocate(void* block, size_t size)
+{
+	size_t index = class_for_size(size);
+	if(index < class_count) {
+		size_class& item = m_classes[index];
+		std::lock_guard<std::mutex> guard(item.lock);
+		if(item.blocks.size() < item.max_cached) {
+			item.blocks.push_back(block);
+			return;
+		}
+	}
+	::operator delete(block);
+}
+
+buffer_pool::statistics buffer_pool::stats()
+{
+	statistics result;
+	result.hits = m_hits.load();
+	result.misses = m_misses.load();
+	for(size_t i = 0; i < class_count; i++) {
+		std::lock_guard<std::mutex> guard(m_classes[i].lock);
+		for(auto& buffer : m_classes[i].buffers) {
+			result.cached_bytes += buffer.capacity();
+		}
+		result.cached_bytes += m_classes[i].blocks.size() * class_size(i);
+	}
+	return result;
+}
+
+} // end of namespace ipc
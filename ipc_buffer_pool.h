@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Per-connection pool of message buffers and small memory blocks with power-of-two size classes.
+// Buffer returned to pool keep its capacity, so steady-state traffic does not call malloc.
+class buffer_pool
+{
+public:
+	static constexpr size_t min_class_bits = 6;   // 64 B
+	static constexpr size_t max_class_bits = 20;  // 1 MB, bigger buffers are not pooled
+
+	struct statistics {
+		uint64_t hits = 0;         // Buffer/block taken from pool
+		uint64_t misses = 0;       // Pool empty (or too big size), allocated
+		size_t cached_bytes = 0;   // Memory held by free buffers/blocks now
+	};
+
+	// Class keep at most max_cached_per_class free buffers (and blocks), but not more than max_cached_class_bytes
+	buffer_pool(size_t max_cached_per_class = 256, size_t max_cached_class_bytes = 4 * 1024 * 1024);
+	~buffer_pool();
+
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator=(const buffer_pool&) = delete;
+
+	// Empty buffer with capacity at least `capacity`
+	std::vector<uint8_t> acquire(size_t capacity);
+	// Give buffer back (content is dropped)
+	void release(std::vector<uint8_t>& buffer);
+
+	// Raw memory block (for allocate_shared of per-message objects)
+	void* allocate(size_t size);
+	void deallocate(void* block, size_t size);
+
+	statistics stats();
+
+private:
+	static constexpr size_t class_count = max_class_bits - min_class_bits + 1;
+
+	// Smallest class which hold `size`, class_count when too big
+	static size_t class_for_size(size_t size);
+	// Biggest class which fit into `capacity`, class_count when too small or too big
+	static size_t class_for_capacity(size_t capacity);
+	static size_t class_size(size_t index) {
+		return size_t(1) << (index + min_class_bits);
+	}
+
+	struct alignas(64) size_class {
+		std::mutex lock;
+		size_t max_cached = 0;
+		std::vector<std::vector<uint8_t>> buffers;
+		std::vector<void*> blocks;
+	};
+
+private:
+	std::array<size_class, class_count> m_classes;
+	std::atomic<uint64_t> m_hits = 0;
+	std::atomic<uint64_t> m_misses = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Allocator taking memory from buffer_pool (keep pool alive while allocated object live)
+template<class T>
+class pool_allocator
+{
+public:
+	using value_type = T;
+
+	pool_allocator(std::shared_ptr<buffer_pool> pool)
+		: m_pool(std::move(pool))
+	{}
+	template<class U>
+	pool_allocator(const pool_allocator<U>& other)
+		: m_pool(other.pool())
+	{}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(m_pool->allocate(count * sizeof(T)));
+	}
+	void deallocate(T* block, size_t count) {
+		m_pool->deallocate(block, count * sizeof(T));
+	}
+
+	const std::shared_ptr<buffer_pool>& pool() const {
+		return m_pool;
+	}
+
+	template<class U>
+	bool operator==(const pool_allocator<U>& other) const {
+		return m_pool == other.pool();
+	}
+	template<class U>
+	bool operator!=(const pool_allocator<U>& other) const {
+		return m_pool != other.pool();
+	}
+
+private:
+	std::shared_ptr<buffer_pool> m_pool;
+};
+
+} // end of namespace ipc
@@ -0,0 +1,60 @@
+// ipc_close_test.cpp : Request handler run by dispatcher worker may end its connection.
+// Slave handler drop the last reference of slave, so slave (and its dispatcher) is destroyed on the worker
+// which run the handler. Process must not terminate and master must see the end of the slave.
+
+#include "stdafx.h"
+#include "ipc_master.h"
+#include "ipc_slave.h"
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int main()
+{
+	auto logger = spdlog::stdout_color_mt("close_test");
+
+	ipc::master::factory master_factory;
+	std::shared_ptr<ipc::master_intf> master_ptr = master_factory.create_master(logger, [](const std::vector<uint8_t>&, std::vector<uint8_t>&) {
+	});
+
+	// Slave on our thread with pipe pair of master, handler own it (last reference)
+	std::mutex slave_lock;
+	std::shared_ptr<ipc::slave_intf> slave_holder;
+	std::promise<void> slave_destroyed;
+	std::thread slave_thread([&, connection = master_ptr->take_slave_connection()]() mutable {
+		ipc::flow_control flow;
+		flow.dispatcher_threads = 2;
+		ipc::slave::factory slave_factory;
+		std::lock_guard<std::mutex> guard(slave_lock);
+		slave_holder = slave_factory.create_slave(logger, connection, [&](const std::vector<uint8_t>&, std::vector<uint8_t>&) {
+			std::shared_ptr<ipc::slave_intf> slave_ptr;
+			{
+				std::lock_guard<std::mutex> guard(slave_lock);
+				slave_ptr = std::move(slave_holder);
+			}
+			if(slave_ptr) {
+				// Handler (its captures) is destroyed with slave, keep what we need on stack
+				std::promise<void>& destroyed = slave_destroyed;
+				slave_ptr->stop();
+				slave_ptr.reset();
+				destroyed.set_value();
+			}
+		}, flow);
+	});
+	master_ptr->start();
+
+	std::vector<uint8_t> message(16, 'x');
+	std::vector<uint8_t> response;
+	bool answered = master_ptr->send(message, response);
+	slave_thread.join();
+	bool destroyed = slave_destroyed.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+	master_ptr->stop();
+
+	logger->info("Request answered:{}, slave destroyed by handler:{}", answered, destroyed);
+	if(answered || !destroyed) {
+		logger->error("Slave closed by its handler must end the request without response");
+		return 1;
+	}
+	return 0;
+}
@@ -5,18 +5,27 @@
 #include "cmdp.h"
 #include "ipc_master.h"
 #include "ipc_slave.h"
+#include "ipc_reactor.h"
 #include "convert.h"
+#include "ipc_bench.h"
 
 //////////////////////////////////////////////////////////////////////////
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 //////////////////////////////////////////////////////////////////////////
 
 void WaitForDebugger()
 {
-#ifdef _DEBUG
+#if defined(_WIN32) && defined(_DEBUG)
 	std::wcout << L"Waiting for debugger...." << std::endl;
 	while(!::IsDebuggerPresent())
 		::Sleep(100);
@@ -24,6 +33,7 @@ void WaitForDebugger()
 #endif
 }
 
+#ifdef _WIN32
 void start_slave(const wchar_t* params, ipc::logger_ptr logger)
 {
 	PROCESS_INFORMATION piProcInfo;
@@ -43,8 +53,165 @@ void start_slave(const wchar_t* params, ipc::logger_ptr logger)
 		logger->error("Create child process fail");
 	}
 }
+#else
+void start_slave(const wchar_t* params, ipc::logger_ptr logger)
+{
+	// Start our own executable, params are separated by spaces
+	std::string path = "/proc/self/exe";
+	std::vector<std::string> args = { path };
+	std::wstringstream params_stream(params);
+	std::wstring param;
+	while(params_stream >> param) {
+		args.push_back(utils::to_utf8(param));
+	}
+	std::vector<char*> argv;
+	for(auto& arg : args) {
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	logger->info("Starting child process '{}' with params'{}'.", path, utils::to_utf8(params));
+
+	pid_t pid = ::fork();
+	if(pid == 0) {
+		::execv(path.c_str(), argv.data());
+		::_exit(127);
+	}
+	if(pid < 0) {
+		logger->error("Create child process fail");
+	}
+}
+#endif
+
+// Threads of this process (0 when it is not known)
+size_t process_threads()
+{
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line)) {
+		if(line.rfind("Threads:", 0) == 0) {
+			return std::stoul(line.substr(8));
+		}
+	}
+#endif
+	return 0;
+}
 
 constexpr int msg_send_count = 3;
+// Parts of streamed response in benchmark (deferred slave handler)
+constexpr int streamed_parts = 16;
+
+// Slave flow control from command line (master pass its options to slave)
+ipc::flow_control slave_flow(cmdp::parser& cmdp)
+{
+	ipc::flow_control flow;
+	cmdp(L"window") >> flow.window_messages;
+	cmdp(L"dispatch") >> flow.dispatcher_threads;
+	cmdp(L"blob") >> flow.large_message_threshold;
+	cmdp(L"bulk") >> flow.bulk_threshold;
+	cmdp(L"pipe-size") >> flow.pipe_buffer_size;
+	cmdp(L"window-bytes") >> flow.window_bytes;
+	return flow;
+}
+
+// Slave side of demo/benchmark (in slave process, or on thread of master process with loopback transport)
+void run_slave(cmdp::parser& cmdp, ipc::client_connection& connection, const ipc::flow_control& flow, ipc::logger_ptr logger)
+{
+	// Benchmark mode, slave only echo messages back
+	bool bench_mode = cmdp[L"bench"];
+
+	ipc::slave::factory slave_factory;
+	std::shared_ptr<ipc::slave_intf> slave_ptr;
+	if(cmdp[L"coro"]) {
+		// Coroutine handler, it can ask master before it answer (read thread is not blocked meanwhile)
+		slave_ptr = slave_factory.create_slave(logger, connection, [&](std::vector<uint8_t> message) -> ipc::task<std::vector<uint8_t>> {
+			if(bench_mode) {
+				co_return message;
+			}
+			logger->info("OnMessage(slave coroutine): '{}'", std::string(message.begin(), message.end()));
+			auto answer = co_await slave_ptr->request(utils::wstring_convert_to_bytes(L"Who is asking?"));
+			if(answer) {
+				logger->info("Nested response is '{}'", std::string(answer->begin(), answer->end()));
+			}
+			co_return utils::wstring_convert_to_bytes(L"I'm slave coroutine response.");
+		}, flow);
+	} else if(cmdp[L"deferred"]) {
+		// Deferred handler, answer from other thread later (read thread is not blocked meanwhile)
+		slave_ptr = slave_factory.create_slave(logger, connection, [&](const std::vector<uint8_t>& message, ipc::responder reply) {
+			if(bench_mode && reply.streamed()) {
+				// Result set like answer, message is echoed back as several parts. Parts wait for requester,
+				// so they are written from other thread (read thread bring its credit)
+				std::thread([reply, message]() mutable {
+					std::shared_ptr<ipc::stream_writer> parts = reply.stream();
+					for(int i = 0; parts && i < streamed_parts && parts->write_part(message); i++) {
+					}
+					if(parts) {
+						parts->close();
+					}
+				}).detach();
+				return;
+			}
+			if(bench_mode) {
+				reply.respond(std::vector<uint8_t>(message));
+				return;
+			}
+			logger->info("OnMessage(slave deferred): '{}'", std::string(message.begin(), message.end()));
+			std::thread([reply]() mutable {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				reply.respond(utils::wstring_convert_to_bytes(L"I'm slave deferred response."));
+			}).detach();
+		}, flow);
+	} else if(cmdp[L"view"]) {
+		// View handler, message is read in place from transport buffer (valid only inside callback)
+		slave_ptr = slave_factory.create_slave(logger, connection, [&](ipc::message_view message, std::vector<uint8_t>& response) {
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(message.data());
+			if(bench_mode) {
+				response.assign(data, data + message.size());
+				return;
+			}
+			logger->info("OnMessage(slave view): '{}'", std::string(reinterpret_cast<const char*>(data), message.size()));
+			response = utils::wstring_convert_to_bytes(L"I'm slave view response.");
+		}, flow);
+	} else {
+		slave_ptr = slave_factory.create_slave(logger, connection, [&](const std::vector<uint8_t>& message, std::vector<uint8_t>& response) {
+			if(bench_mode) {
+				response = message;
+				return;
+			}
+			logger->info("OnMessage(slave): '{}'", std::string(message.begin(), message.end()));
+			response = utils::wstring_convert_to_bytes(L"I'm slave response.");
+		}, flow);
+	}
+
+	if(bench_mode) {
+		// Echo streams back (each one by new stream), serve until master disconnect
+		std::thread stream_echo([&]() {
+			while(std::shared_ptr<ipc::stream_reader> reader = slave_ptr->accept_stream()) {
+				std::shared_ptr<ipc::stream_writer> writer = slave_ptr->open_stream(ipc::to_view(reader->metadata()));
+				std::vector<uint8_t> chunk;
+				while(writer && reader->read(chunk) && writer->write(chunk)) {
+				}
+				if(writer && reader->succeeded()) {
+					writer->close();
+				}
+			}
+		});
+		slave_ptr->wait();
+		stream_echo.join();
+	} else {
+		for(int i = 0; i < msg_send_count; i++) {
+			std::vector<uint8_t> response;
+			std::vector<uint8_t> msg = utils::wstring_convert_to_bytes(L"I'm slave message.");
+			slave_ptr->send(msg, response);
+			logger->info("Response is '{}'", std::string(response.begin(), response.end()));
+		}
+
+		std::this_thread::sleep_for(std::chrono::seconds(15));
+	}
+
+	slave_ptr->stop();
+}
 
 int wmain(int argc, wchar_t *argv[])
 {
@@ -53,56 +220,183 @@ int wmain(int argc, wchar_t *argv[])
 
 	cmdp::parser cmdp(argc, argv);
 
+	// Benchmark mode, slave only echo messages back
+	bool bench_mode = cmdp[L"bench"];
+
 	if(cmdp[L"pipe-master"]) {
 		logger->info("Hello I'm your MASTER!");
 
+		ipc::transport_type type = ipc::default_transport;
+		if(cmdp[L"shm"]) {
+			type = ipc::transport_type::shared_memory;
+		} else if(cmdp[L"sock"]) {
+			type = ipc::transport_type::socket;
+		} else if(cmdp[L"seqpacket"]) {
+			type = ipc::transport_type::seqpacket;
+		} else if(cmdp[L"loopback"]) {
+			type = ipc::transport_type::loopback;
+		} else if(cmdp[L"uring"]) {
+			type = ipc::transport_type::io_uring;
+		}
+
+		// Big messages go through shared memory blob instead of transport
+		ipc::flow_control flow;
+		cmdp(L"blob") >> flow.large_message_threshold;
+		// Bulk pipe transfer, sweep payloads need window for the biggest one
+		cmdp(L"bulk") >> flow.bulk_threshold;
+		cmdp(L"pipe-size") >> flow.pipe_buffer_size;
+		bool sweep_mode = bench_mode && cmdp[L"sweep"];
+		if(sweep_mode) {
+			flow.window_bytes = 1024 * 1024 * 1024;
+			cmdp(L"size") >> flow.window_bytes;
+		}
+		// Reads of all our masters are served by shared event loop instead of read thread each
+		uint32_t reactor_threads = 0;
+		if(cmdp(L"reactor") >> reactor_threads) {
+#ifdef __linux__
+			flow.reactor = std::make_shared<ipc::reactor>(reactor_threads);
+#else
+			logger->warn("Reactor is not supported on this platform, using read threads");
+#endif
+		}
+
 		ipc::master::factory master_factory;
 		std::shared_ptr<ipc::master_intf> master_ptr = master_factory.create_master(logger, [&](const std::vector<uint8_t>& message, std::vector<uint8_t>& response) {
 			logger->info("OnMessage(master): '{}'", std::string(message.begin(), message.end()));
 			response = utils::wstring_convert_to_bytes(L"I'm master response.");
-		});
+		}, type, flow);
 
-		start_slave(master_ptr->cmd_pipe_params().c_str(), logger);
+		std::wstring slave_params = master_ptr->cmd_pipe_params();
+		if(bench_mode) {
+			slave_params += L" /bench";
+		}
+		if(cmdp[L"coro"]) {
+			slave_params += L" /coro";
+		}
+		if(cmdp[L"deferred"]) {
+			slave_params += L" /deferred";
+		}
+		if(cmdp[L"view"]) {
+			slave_params += L" /view";
+		}
+		uint32_t window = 0;
+		if(cmdp(L"window") >> window) {
+			slave_params += L" /window=" + std::to_wstring(window);
+		}
+		uint32_t dispatch = 0;
+		if(cmdp(L"dispatch") >> dispatch) {
+			slave_params += L" /dispatch=" + std::to_wstring(dispatch);
+		}
+		if(flow.large_message_threshold) {
+			slave_params += L" /blob=" + std::to_wstring(flow.large_message_threshold);
+		}
+		if(flow.bulk_threshold) {
+			slave_params += L" /bulk=" + std::to_wstring(flow.bulk_threshold);
+		}
+		if(flow.pipe_buffer_size) {
+			slave_params += L" /pipe-size=" + std::to_wstring(flow.pipe_buffer_size);
+		}
+		if(sweep_mode) {
+			slave_params += L" /window-bytes=" + std::to_wstring(flow.window_bytes);
+		}
+		std::thread slave_thread;
+		if(type == ipc::transport_type::loopback) {
+			// Slave on our thread, same options as slave process would get
+			ipc::flow_control loopback_flow = slave_flow(cmdp);
+			loopback_flow.window_bytes = flow.window_bytes;
+			slave_thread = std::thread([&, loopback_flow, connection = master_ptr->take_slave_connection()]() mutable {
+				run_slave(cmdp, connection, loopback_flow, logger);
+			});
+		} else {
+			start_slave(slave_params.c_str(), logger);
+		}
 
 		master_ptr->start();
-	
-		for(int i = 0; i < msg_send_count; i++) {
-			std::vector<uint8_t> response;
-			std::vector<uint8_t> msg = utils::wstring_convert_to_bytes(L"I'm master message.");
-			master_ptr->send(msg, response);
-			logger->info("Response is '{}'", std::string(response.begin(), response.end()));
+
+		// Idle slaves supervised together with benchmarked one (compare thread count with and without reactor)
+		uint32_t slaves = 1;
+		cmdp(L"slaves") >> slaves;
+		std::vector<std::shared_ptr<ipc::master_intf>> idle_masters;
+		for(uint32_t i = 1; i < slaves && type != ipc::transport_type::loopback; i++) {
+			std::shared_ptr<ipc::master_intf> idle = master_factory.create_master(logger, [](const std::vector<uint8_t>&, std::vector<uint8_t>&) {
+			}, type, flow);
+			start_slave((idle->cmd_pipe_params() + L" /bench").c_str(), logger);
+			idle->start();
+			idle_masters.push_back(idle);
 		}
 
-		::Sleep(15000);
+		if(bench_mode) {
+			bench::options opt;
+			cmdp(L"count") >> opt.count;
+			cmdp(L"size") >> opt.size;
+			cmdp(L"threads") >> opt.threads;
+			cmdp(L"depth") >> opt.depth;
+			cmdp(L"parts") >> opt.parts;
+			opt.one_way = cmdp[L"post"];
+			if(sweep_mode) {
+				opt.size = flow.window_bytes;
+				bench::sweep(*master_ptr, opt, logger);
+			} else if(cmdp[L"stream"]) {
+				bench::stream(*master_ptr, opt, logger);
+			} else if(cmdp[L"streamed"]) {
+				bench::streamed(*master_ptr, opt, logger);
+			} else if(opt.one_way) {
+				bench::one_way(*master_ptr, opt, logger);
+			} else if(opt.depth) {
+				bench::pipeline(*master_ptr, opt, logger);
+			} else {
+				bench::ping_pong(*master_ptr, opt, logger);
+			}
+			logger->info("Slaves:{}, process threads:{}", idle_masters.size() + 1, process_threads());
+		} else {
+			for(int i = 0; i < msg_send_count; i++) {
+				std::vector<uint8_t> response;
+				std::vector<uint8_t> msg = utils::wstring_convert_to_bytes(L"I'm master message.");
+				master_ptr->send(msg, response);
+				logger->info("Response is '{}'", std::string(response.begin(), response.end()));
+			}
 
+			std::this_thread::sleep_for(std::chrono::seconds(15));
+		}
+
+		for(std::shared_ptr<ipc::master_intf>& idle : idle_masters) {
+			idle->stop();
+		}
 		master_ptr->stop();
+		if(slave_thread.joinable()) {
+			slave_thread.join();
+		}
 	}
 	else if(cmdp[L"pipe-slave"]) {
 
 		ipc::client_connection connection;
 		cmdp(L"pipe-r") >> connection.read_pipe;
 		cmdp(L"pipe-w") >> connection.write_pipe;
+		cmdp(L"shm") >> connection.shared_memory;
+		cmdp(L"sock") >> connection.socket;
+		connection.io_uring = cmdp[L"uring"];
 
 		logger->info("Hello I'm your SLAVE (read-pipe:{}, write-pipe:{})", connection.read_pipe, connection.write_pipe);
 
-		ipc::slave::factory slave_factory;
-		std::shared_ptr<ipc::slave_intf> slave_ptr = slave_factory.create_slave(logger, connection, [&](const std::vector<uint8_t>& message, std::vector<uint8_t>& response) {
-			logger->info("OnMessage(slave): '{}'", std::string(message.begin(), message.end()));
-			response = utils::wstring_convert_to_bytes(L"I'm slave response.");
-		});
-
-		for(int i = 0; i < msg_send_count; i++) {
-			std::vector<uint8_t> response;
-			std::vector<uint8_t> msg = utils::wstring_convert_to_bytes(L"I'm slave message.");
-			slave_ptr->send(msg, response);
-			logger->info("Response is '{}'", std::string(response.begin(), response.end()));
-		}
-
-		::Sleep(15000);
-
-		slave_ptr->stop();
+		run_slave(cmdp, connection, slave_flow(cmdp), logger);
 	}
 
     return 0;
 }
 
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+	// Same command line handling as on Windows (wide strings)
+	std::vector<std::wstring> args;
+	for(int i = 0; i < argc; i++) {
+		std::string arg(argv[i]);
+		args.push_back(utils::wstring_convert_from_bytes(arg));
+	}
+	std::vector<wchar_t*> wargv;
+	for(auto& arg : args) {
+		wargv.push_back(&arg[0]);
+	}
+	return wmain(argc, wargv.data());
+}
+#endif
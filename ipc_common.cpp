@@ -2,17 +2,53 @@
 #include "ipc_common.h"
 #include "scope_guard.h"
 #include "convert.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
 
 namespace ipc {
 
-common::common(logger_ptr logger, message_callback_fn callback_fn)
+// Connection whose frames this thread read now (its read thread, or reactor thread in its handler)
+static thread_local const common* reading_connection = nullptr;
+// Reactor loop thread handle frames now (it must not run user code)
+static thread_local bool reactor_loop_thread = false;
+// Connection released by this thread (its request handler ended it), it must not be touched after the handler
+static thread_local const common* released_connection = nullptr;
+
+common::common(logger_ptr logger, message_callback_fn callback_fn, const flow_control& flow)
 	: logger_holder(logger)
+	, m_shutdown_event(true)
+	, m_flow(flow)
 	, m_callback_fn(callback_fn)
 {
-	m_shutdown_event = ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
-	if(!m_shutdown_event) {
-		throw std::runtime_error(utils::win32_error_to_ansi(::GetLastError()));
-	}
+	create_channels();
+}
+
+common::common(logger_ptr logger, coro_message_callback_fn callback_fn, const flow_control& flow)
+	: logger_holder(logger)
+	, m_shutdown_event(true)
+	, m_flow(flow)
+	, m_coro_callback_fn(callback_fn)
+{
+	create_channels();
+}
+
+common::common(logger_ptr logger, deferred_message_callback_fn callback_fn, const flow_control& flow)
+	: logger_holder(logger)
+	, m_shutdown_event(true)
+	, m_flow(flow)
+	, m_deferred_callback_fn(callback_fn)
+{
+	create_channels();
+}
+
+common::common(logger_ptr logger, view_message_callback_fn callback_fn, const flow_control& flow)
+	: logger_holder(logger)
+	, m_shutdown_event(true)
+	, m_flow(flow)
+	, m_view_callback_fn(callback_fn)
+{
+	create_channels();
 }
 
 common::~common()
@@ -22,43 +58,69 @@ common::~common()
 	} catch(...) {}
 }
 
+void common::create_channels()
+{
+	m_response_channel = std::make_shared<response_channel>([this](uint32_t id, bool streamed, std::vector<uint8_t>& response) {
+		return send_response(id, streamed, response);
+	}, [this](uint32_t id) {
+		return open_response_stream(id);
+	});
+	m_stream_channel = std::make_shared<stream_channel>([this](const header& header_data, message_view payload) {
+		return write_stream_frame(header_data, payload);
+	}, [this]() {
+		return is_reading_thread();
+	});
+}
+
 void common::release()
 {
+	released_connection = this;
 	close_communication();
+	// Responders and streams can outlive us, they must not touch us anymore
+	m_response_channel->close();
+	m_stream_channel->close();
 
-	// Wait for thread
-	if(m_read_thread) {
-		if(::WaitForSingleObject(m_read_thread, INFINITE) == WAIT_TIMEOUT) {
-			::TerminateThread(m_read_thread, 1);
-		}
-		::CloseHandle(m_read_thread);
-		m_read_thread = nullptr;
+	// Wait for thread (do not wait until other side close its write direction, it may hang)
+	if(m_transport) {
+		m_transport->wakeup();
 	}
-
-	// Write-pipe already closed in (close_communication), so close also read-pipe
-	if(m_connection.read_pipe) {
-		::CloseHandle(m_connection.read_pipe);
-		m_connection.read_pipe = nullptr;
+	stop_reactor_reads();
+	if(m_read_thread.joinable()) {
+		m_read_thread.join();
+	}
+	// Workers can not send anything now, drop not handled requests
+	if(m_dispatcher) {
+		m_dispatcher->stop();
 	}
 
-	// Close event
-	if(m_shutdown_event) {
-		::CloseHandle(m_shutdown_event);
-		m_shutdown_event = nullptr;
+	// Write-pipe already closed in (close_communication), so close also read-pipe
+	if(m_transport) {
+		m_transport->close_read();
 	}
+	close_blobs();
 }
 
-void common::start_communication(client_connection& connection)
+void common::start_communication(std::unique_ptr<transport> transport)
 {
 	if(!m_comm_running) {
-		m_connection = connection;
-
-		DWORD thread_id = 0;
-		m_read_thread = ::CreateThread(nullptr, 0, &common::read_thread_win_proc, this, 0, &thread_id);
-		if(!m_read_thread) {
-			throw std::runtime_error(utils::win32_error_to_ansi(::GetLastError()));
+		m_transport = std::move(transport);
+		if(std::shared_ptr<buffer_pool> shared_pool = m_transport->shared_buffer_pool()) {
+			m_buffer_pool = std::move(shared_pool);
+		}
+		m_transport->set_max_message_size(m_flow.window_bytes);
+		m_transport->set_buffer_pool(m_buffer_pool);
+		m_transport->set_bulk_mode(m_flow.bulk_threshold, m_flow.pipe_buffer_size);
+		if(m_flow.dispatcher_threads) {
+			m_dispatcher = std::make_unique<dispatcher>(m_flow.dispatcher_threads);
 		}
 		m_comm_running = true;
+		if(!start_reactor_reads()) {
+			m_read_thread = std::thread(&common::read_thread, this);
+		}
+
+		// Tell other side how much it can send us
+		write_system_message(SYSTEM_MSG_WINDOW, m_flow.window_messages, m_flow.window_bytes);
+		write_system_message(SYSTEM_MSG_STREAM_WINDOW, 0, m_flow.stream_window_bytes);
 	}
 }
 
@@ -67,108 +129,610 @@ void common::close_communication()
 	m_comm_running = false;
 
 	// Set shutdown event (will stop all response wait)
-	if(m_shutdown_event != nullptr) {
-		::SetEvent(m_shutdown_event);
-	}
+	m_shutdown_event.set();
 
 	{
 		std::lock_guard<std::mutex> one_send_guard(m_write_lock);
 		// Close our write pipe (this will abort ReadFile on other side and the other side must also close write pipe)
-		if(m_connection.write_pipe) {
-			::CloseHandle(m_connection.write_pipe);
-			m_connection.write_pipe = nullptr;
+		if(m_transport) {
+			m_transport->close_write();
 		}
 	}
+
+	// Wake up senders waiting for credit
+	{
+		std::lock_guard<std::mutex> credit_guard(m_credit_lock);
+		m_credit_changed.notify_all();
+	}
+
+	// Nobody will answer now
+	fail_pending_messages();
+	end_streams();
+}
+
+buffer_pool::statistics common::buffer_pool_stats()
+{
+	return m_buffer_pool->stats();
+}
+
+void common::wait_for_close()
+{
+	platform::event* wait_events[] = { &m_shutdown_event };
+	platform::wait_for_any(wait_events, 1);
 }
 
 #pragma region Send
 bool common::send(std::vector<uint8_t>& message, std::vector<uint8_t>& response)
 {
-	// Add message info to map for response wait
-	std::shared_ptr<ipc::response_message> new_msg = std::make_shared<ipc::response_message>(message_id::new_id());
-	m_pending_send_msgs.insert(std::make_pair(new_msg->id(), new_msg));
-	// Create guard to auto remove message from map
+	// We wait for response, so other side read whole message before message can change
+	message_view part = to_view(message);
+	async_response pending_response = send_async(message_parts(&part, 1), true);
+	return pending_response.get(response);
+}
+
+async_response common::send_async(const std::vector<uint8_t>& message)
+{
+	message_view part = to_view(message);
+	return send_async(message_parts(&part, 1));
+}
+
+async_response common::send_async(message_parts message)
+{
+	return send_async(message, false);
+}
+
+async_response common::send_async(message_parts message, bool stable_message)
+{
+	size_t message_size = 0;
+	for(const message_view& part : message) {
+		message_size += part.size();
+	}
+
+	// Add message info to pending table for response wait (table gives message its id)
+	std::shared_ptr<ipc::response_message> new_msg = std::allocate_shared<ipc::response_message>(pool_allocator<ipc::response_message>(m_buffer_pool), 0, m_buffer_pool);
+	uint32_t msg_id = m_pending_send_msgs.claim(new_msg);
+	if(msg_id == 0) {
+		logger()->error("Too many messages waiting for response");
+		std::vector<uint8_t> no_response;
+		new_msg->complete(false, no_response);
+		return async_response(new_msg);
+	}
+	new_msg->set_id(msg_id);
+	// Create guard to complete message as failed when write fail
 	utils::scope_guard guard = [&]() {
-		m_pending_send_msgs.erase(new_msg->id());
+		if(m_pending_send_msgs.take(msg_id)) {
+			std::vector<uint8_t> no_response;
+			new_msg->complete(false, no_response);
+		}
 	};
 
-	DWORD written_bytes = 0;
+	if(message_size > UINT32_MAX || !acquire_send_credit(static_cast<uint32_t>(message_size))) {
+		return async_response(new_msg);
+	}
+
 	//////////////////////////////////////////////////////////////////////////
 	// Only WriteFile at the time
 	{
 		std::lock_guard<std::mutex> one_send_guard(m_write_lock);
-		if(!m_comm_running) return false;
+		if(!m_comm_running) return async_response(new_msg);
 
 		//////////////////////////////////////////////////////////////////////////
-		// Write header
-		auto header_data = std::make_unique<header>();
-		header_data->id = new_msg->id();
-		header_data->flags = HEADER_FLAG_USER_MSG;
-		header_data->message_size = message.size();
-
-		if(!::WriteFile(m_connection.write_pipe, header_data.get(), sizeof(ipc::header), &written_bytes, nullptr)) {
-			logger()->error("Write header fail: {}", ::GetLastError());
+		// Write header + message
+		header header_data;
+		header_data.id = msg_id;
+		header_data.flags = HEADER_FLAG_USER_MSG;
+		header_data.message_size = static_cast<uint32_t>(message_size);
+
+		if(write_message(header_data, message, stable_message) != platform::io_result::ok) {
+			logger()->error("Write message fail: {}", platform::last_error());
+			return async_response(new_msg);
+		}
+	}
+
+	// Message is on the way, response (or communication end) complete it
+	guard.dismiss();
+	return async_response(new_msg);
+}
+
+bool common::post(const std::vector<uint8_t>& message)
+{
+	message_view part = to_view(message);
+	return post(message_parts(&part, 1));
+}
+
+bool common::post(message_parts message)
+{
+	size_t message_size = 0;
+	for(const message_view& part : message) {
+		message_size += part.size();
+	}
+	if(message_size > UINT32_MAX) {
+		return false;
+	}
+
+	// No response, so no pending message and no id
+	header header_data;
+	header_data.flags = HEADER_FLAG_USER_MSG_ONE_WAY;
+	header_data.message_size = static_cast<uint32_t>(message_size);
+
+	if(!acquire_send_credit(header_data.message_size)) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> one_send_guard(m_write_lock);
+	if(!m_comm_running) return false;
+
+	if(write_message(header_data, message) != platform::io_result::ok) {
+		logger()->error("Write message fail: {}", platform::last_error());
+		return false;
+	}
+	return true;
+}
+
+#pragma region FlowControl
+bool common::write_system_message(uint32_t type, uint32_t messages, uint32_t bytes)
+{
+	system_message message_data;
+	message_data.type = type;
+	message_data.messages = messages;
+	message_data.bytes = bytes;
+
+	header header_data;
+	header_data.flags = HEADER_FLAG_SYSTEM_MSG;
+	header_data.message_size = sizeof(system_message);
+
+	std::lock_guard<std::mutex> one_send_guard(m_write_lock);
+	if(!m_comm_running) return false;
+
+	if(m_transport->write_frame(header_data, &message_data, sizeof(system_message)) != platform::io_result::ok) {
+		logger()->error("Write system message fail: {}", platform::last_error());
+		return false;
+	}
+	return true;
+}
+
+bool common::acquire_send_credit(uint32_t size)
+{
+	std::unique_lock<std::mutex> credit_guard(m_credit_lock);
+
+	auto has_credit = [&]() {
+		return !m_comm_running || (m_peer_window_known && m_credit_messages > 0 && m_credit_bytes >= size);
+	};
+
+	if(!has_credit()) {
+		// Read thread must never wait, it is the one who receive credit
+		if(m_flow.fail_fast || is_reading_thread()) {
+			logger()->warn("No send credit (messages:{:d}, bytes:{:d})", m_credit_messages, m_credit_bytes);
 			return false;
 		}
+		m_credit_changed.wait(credit_guard, has_credit);
+	}
+	if(!m_comm_running) {
+		return false;
+	}
+	if(size > m_peer_max_size) {
+		logger()->error("Message too big for other side ({:d} > {:d})", size, m_peer_max_size);
+		return false;
+	}
 
-		//////////////////////////////////////////////////////////////////////////
-		// Write message
-		if(message.size()) {
-			if(!::WriteFile(m_connection.write_pipe, message.data(), (DWORD)message.size(), &written_bytes, nullptr)) {
-				logger()->error("Write message fail: {}", ::GetLastError());
-				return false;
+	m_credit_messages--;
+	m_credit_bytes -= size;
+	return true;
+}
+
+void common::on_system_message(message_view message)
+{
+	if(message.size() != sizeof(system_message)) {
+		logger()->error("Invalid system message size {:d}", message.size());
+		return;
+	}
+	system_message message_data;
+	::memcpy(&message_data, message.data(), sizeof(system_message));
+
+	if(message_data.type == SYSTEM_MSG_BLOB_RELEASE) {
+		release_blob(message_data.messages);
+		return;
+	}
+	if(message_data.type == SYSTEM_MSG_STREAM_CREDIT || message_data.type == SYSTEM_MSG_STREAM_CANCEL) {
+		std::shared_ptr<stream_writer> writer;
+		{
+			std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+			auto it = m_stream_writers.find(message_data.messages);
+			if(it != m_stream_writers.end()) {
+				writer = it->second.lock();
 			}
 		}
+		if(writer && message_data.type == SYSTEM_MSG_STREAM_CREDIT) {
+			writer->add_credit(message_data.bytes);
+		} else if(writer) {
+			writer->cancel();
+		}
+		return;
 	}
 
-	// Wait for response
-	HANDLE wait_handles[2] = {0};
-	wait_handles[0] = m_shutdown_event;
-	wait_handles[1] = new_msg->event();
-	DWORD wait_result = WaitForMultipleObjects(
-		_countof(wait_handles),   // number of handles in array
-		wait_handles,             // array of thread handles
-		FALSE,                    // wait until all are signaled
-		INFINITE);
-
-	switch(wait_result) {
-	case WAIT_OBJECT_0:	// m_shutdown_event signaled
-		return false; // End 
-	case WAIT_OBJECT_0 + 1: // new_msg->event signaled
-		response = m_pending_send_msgs[new_msg->id()]->response_buffer();
-		break;
-	default: // error
-		std::exception("Wait for message response fail");
-		return false;
+	std::lock_guard<std::mutex> credit_guard(m_credit_lock);
+	if(message_data.type == SYSTEM_MSG_WINDOW) {
+		m_peer_window_known = true;
+		m_peer_max_size = message_data.bytes;
+		m_credit_messages = message_data.messages;
+		m_credit_bytes = message_data.bytes;
+	} else if(message_data.type == SYSTEM_MSG_CREDIT) {
+		m_credit_messages += message_data.messages;
+		m_credit_bytes += message_data.bytes;
+	} else if(message_data.type == SYSTEM_MSG_STREAM_WINDOW) {
+		m_peer_stream_window = message_data.bytes;
 	}
+	m_credit_changed.notify_all();
+}
 
-	return true;
+void common::give_back_credit(uint32_t size)
+{
+	std::lock_guard<std::mutex> consumed_guard(m_consumed_lock);
+	m_consumed_messages++;
+	m_consumed_bytes += size;
+
+	// Batch credit messages, but give back soon enough so other side never stall on full window
+	if(m_consumed_messages >= std::max<uint32_t>(m_flow.window_messages / 4, 1) || m_consumed_bytes >= m_flow.window_bytes / 4) {
+		if(write_system_message(SYSTEM_MSG_CREDIT, m_consumed_messages, static_cast<uint32_t>(m_consumed_bytes))) {
+			m_consumed_messages = 0;
+			m_consumed_bytes = 0;
+		}
+	}
 }
+#pragma endregion FlowControl
 
+#pragma region Stream
+uint32_t common::next_stream_id()
+{
+	// Top bit mark response streams (id chosen by requester), so ids of both sides never collide
+	uint32_t id = 0;
+	while(id == 0) {
+		id = m_next_stream_id++ & ~STREAM_ID_RESPONSE;
+	}
+	return id;
+}
 
-bool common::send_response(std::shared_ptr<ipc::header> header, std::vector<uint8_t>& response)
+std::shared_ptr<stream_writer> common::create_stream_writer(uint32_t id)
 {
-	DWORD written_bytes = 0;
-	//////////////////////////////////////////////////////////////////////////
-	// Only WriteFile at the time
+	// Other side announce its stream window right after start
+	uint32_t window = 0;
+	uint32_t max_size = 0;
+	{
+		std::unique_lock<std::mutex> credit_guard(m_credit_lock);
+		auto window_known = [&]() {
+			return !m_comm_running || (m_peer_window_known && m_peer_stream_window > 0);
+		};
+		if(!window_known() && !is_reading_thread()) {
+			m_credit_changed.wait(credit_guard, window_known);
+		}
+		if(!m_comm_running || !window_known()) {
+			return nullptr;
+		}
+		window = m_peer_stream_window;
+		max_size = m_peer_max_size;
+	}
+
+	// Chunk is at most half of window, so writer never wait for credit reader keep for batching
+	uint32_t chunk_size = std::min({ m_flow.stream_chunk_size, window / 2, max_size });
+	std::shared_ptr<stream_writer> writer = std::make_shared<stream_writer>(m_stream_channel, id, chunk_size, window);
+	std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+	m_stream_writers[id] = writer;
+	return writer;
+}
+
+std::shared_ptr<stream_writer> common::open_stream(message_view metadata)
+{
+	uint32_t id = next_stream_id();
+	std::shared_ptr<stream_writer> writer = create_stream_writer(id);
+	if(!writer) {
+		return nullptr;
+	}
+
+	header header_data;
+	header_data.id = id;
+	header_data.flags = HEADER_FLAG_STREAM_OPEN;
+	header_data.message_size = static_cast<uint32_t>(metadata.size());
+	if(metadata.size() > UINT32_MAX || !write_stream_frame(header_data, metadata)) {
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		m_stream_writers.erase(id);
+		return nullptr;
+	}
+	return writer;
+}
+
+std::shared_ptr<stream_writer> common::open_response_stream(uint32_t id)
+{
+	// Requester has reader ready, no open frame
+	return create_stream_writer(id);
+}
+
+std::shared_ptr<stream_reader> common::send_streamed(message_parts message)
+{
+	size_t message_size = 0;
+	for(const message_view& part : message) {
+		message_size += part.size();
+	}
+	if(message_size > UINT32_MAX || !acquire_send_credit(static_cast<uint32_t>(message_size))) {
+		return nullptr;
+	}
+
+	// Reader exist before request is written, so no part can come before it
+	uint32_t id = next_stream_id() | STREAM_ID_RESPONSE;
+	std::shared_ptr<stream_reader> reader = std::make_shared<stream_reader>(m_stream_channel, id, m_flow.stream_window_bytes, std::vector<uint8_t>(), m_buffer_pool);
+	{
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		m_stream_readers[id] = reader;
+	}
+
+	bool written = false;
 	{
 		std::lock_guard<std::mutex> one_send_guard(m_write_lock);
-		if(!m_comm_running) return false;
+		if(m_comm_running) {
+			header header_data;
+			header_data.id = id;
+			header_data.flags = HEADER_FLAG_USER_MSG_STREAMED;
+			header_data.message_size = static_cast<uint32_t>(message_size);
+			written = write_message(header_data, message) == platform::io_result::ok;
+			if(!written) {
+				logger()->error("Write message fail: {}", platform::last_error());
+			}
+		}
+	}
+	if(!written) {
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		m_stream_readers.erase(id);
+		return nullptr;
+	}
+	return reader;
+}
 
-		//////////////////////////////////////////////////////////////////////////
-		// Write header
-		header->flags = HEADER_FLAG_USER_MSG_RESPONSE;
-		header->message_size = response.size();
+std::shared_ptr<stream_reader> common::accept_stream(uint32_t timeout_ms)
+{
+	std::unique_lock<std::mutex> stream_guard(m_stream_lock);
+	auto has_stream = [&]() {
+		return !m_incoming_streams.empty() || !m_comm_running;
+	};
+	if(timeout_ms == platform::wait_infinite) {
+		m_stream_opened.wait(stream_guard, has_stream);
+	} else {
+		m_stream_opened.wait_for(stream_guard, std::chrono::milliseconds(timeout_ms), has_stream);
+	}
+
+	// Streams received before communication ended can be still read
+	if(m_incoming_streams.empty()) {
+		return nullptr;
+	}
+	std::shared_ptr<stream_reader> reader = std::move(m_incoming_streams.front());
+	m_incoming_streams.pop_front();
+	return reader;
+}
+
+bool common::write_stream_frame(const header& header_data, message_view payload)
+{
+	if(header_data.flags == HEADER_FLAG_STREAM_END || header_data.flags == HEADER_FLAG_STREAM_ABORT) {
+		// Writer is finished, credit and cancel do not matter anymore
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		m_stream_writers.erase(header_data.id);
+	}
+
+	std::lock_guard<std::mutex> one_send_guard(m_write_lock);
+	if(!m_comm_running) return false;
+
+	header frame_header = header_data;
+	if(write_message(frame_header, message_parts(&payload, 1)) != platform::io_result::ok) {
+		logger()->error("Write stream frame fail: {}", platform::last_error());
+		return false;
+	}
+	return true;
+}
+
+void common::on_stream_frame(const header& header_data, std::vector<uint8_t>& message)
+{
+	std::shared_ptr<stream_reader> reader;
+	{
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		if(header_data.flags == HEADER_FLAG_STREAM_OPEN) {
+			// Wait in queue until accepted, chunks are buffered meanwhile (at most our window)
+			reader = std::make_shared<stream_reader>(m_stream_channel, header_data.id, m_flow.stream_window_bytes, std::move(message), m_buffer_pool);
+			m_stream_readers[header_data.id] = reader;
+			m_incoming_streams.push_back(reader);
+			m_stream_opened.notify_one();
+			return;
+		}
+
+		auto it = m_stream_readers.find(header_data.id);
+		if(it != m_stream_readers.end()) {
+			reader = it->second.lock();
+			if(header_data.flags != HEADER_FLAG_STREAM_DATA) {
+				m_stream_readers.erase(it);
+			}
+		}
+	}
+
+	// No reader, it was dropped (cancel is on the way to writer)
+	if(!reader) {
+		return;
+	}
+	if(header_data.flags == HEADER_FLAG_STREAM_DATA) {
+		reader->push(message);
+	} else {
+		reader->finish(header_data.flags == HEADER_FLAG_STREAM_END);
+	}
+}
+
+void common::end_streams()
+{
+	std::vector<std::shared_ptr<stream_writer>> writers;
+	std::vector<std::shared_ptr<stream_reader>> readers;
+	{
+		std::lock_guard<std::mutex> stream_guard(m_stream_lock);
+		for(auto& [id, writer] : m_stream_writers) {
+			if(std::shared_ptr<stream_writer> target = writer.lock()) {
+				writers.push_back(std::move(target));
+			}
+		}
+		for(auto& [id, reader] : m_stream_readers) {
+			if(std::shared_ptr<stream_reader> target = reader.lock()) {
+				readers.push_back(std::move(target));
+			}
+		}
+		m_stream_writers.clear();
+		m_stream_readers.clear();
+		m_stream_opened.notify_all();
+	}
+
+	for(std::shared_ptr<stream_writer>& writer : writers) {
+		writer->cancel();
+	}
+	for(std::shared_ptr<stream_reader>& reader : readers) {
+		reader->finish(false);
+	}
+}
+#pragma endregion Stream
+
+#pragma region LargeMessage
+platform::io_result common::write_message(header& header_data, message_parts message, bool stable_message)
+{
+	if(!m_flow.large_message_threshold || header_data.message_size < m_flow.large_message_threshold) {
+		return stable_message ? m_transport->write_frame_stable(header_data, message) : m_transport->write_frame(header_data, message);
+	}
+
+	// Copy message into blob, other side map it (transport carry only descriptor)
+	native_handle blob = invalid_handle;
+	void* view = nullptr;
+	if(!platform::create_blob(header_data.message_size, blob, view)) {
+		logger()->error("Create blob fail: {}", platform::last_error());
+		return platform::io_result::failed;
+	}
+	size_t offset = 0;
+	for(const message_view& part : message) {
+		if(!part.empty()) {
+			::memcpy(static_cast<uint8_t*>(view) + offset, part.data(), part.size());
+			offset += part.size();
+		}
+	}
+	if(!platform::seal_blob(blob, view, header_data.message_size)) {
+		logger()->error("Seal blob fail: {}", platform::last_error());
+		return platform::io_result::failed;
+	}
+
+	blob_descriptor descriptor;
+	descriptor.size = header_data.message_size;
+	descriptor.process_id = platform::current_process_id();
+	descriptor.handle = platform::handle_value(blob);
+
+	// Handle must stay open until other side open it (it send BLOB_RELEASE then)
+	{
+		std::lock_guard<std::mutex> blob_guard(m_blob_lock);
+		m_pending_blobs.push_back(blob);
+	}
+
+	header blob_header = header_data;
+	blob_header.flags |= HEADER_FLAG_BLOB;
+	blob_header.message_size = sizeof(blob_descriptor);
+	platform::io_result result = m_transport->write_frame(blob_header, &descriptor, sizeof(blob_descriptor));
+	if(result != platform::io_result::ok) {
+		release_blob(descriptor.handle);
+	}
+	return result;
+}
+
+void common::release_blob(uint32_t handle)
+{
+	native_handle blob = invalid_handle;
+	{
+		std::lock_guard<std::mutex> blob_guard(m_blob_lock);
+		auto it = std::find_if(m_pending_blobs.begin(), m_pending_blobs.end(), [handle](native_handle pending) {
+			return platform::handle_value(pending) == handle;
+		});
+		if(it == m_pending_blobs.end()) {
+			logger()->warn("Release of unknown blob {:d}", handle);
+			return;
+		}
+		blob = *it;
+		*it = m_pending_blobs.back();
+		m_pending_blobs.pop_back();
+	}
+	platform::close_handle(blob);
+}
+
+void common::close_blobs()
+{
+	std::lock_guard<std::mutex> blob_guard(m_blob_lock);
+	for(native_handle& blob : m_pending_blobs) {
+		platform::close_handle(blob);
+	}
+	m_pending_blobs.clear();
+}
+
+bool common::open_blob(message_view descriptor, platform::mapped_blob& blob)
+{
+	if(descriptor.size() != sizeof(blob_descriptor)) {
+		logger()->error("Invalid blob descriptor size {:d}", descriptor.size());
+		return false;
+	}
+	blob_descriptor descriptor_data;
+	::memcpy(&descriptor_data, descriptor.data(), sizeof(blob_descriptor));
+
+	// Blob is also limited by our window (other side acquired credit for its size)
+	bool opened = false;
+	if(descriptor_data.size > m_flow.window_bytes) {
+		logger()->error("Blob too big ({:d} > {:d})", descriptor_data.size, m_flow.window_bytes);
+	} else if(!blob.open(descriptor_data.process_id, descriptor_data.handle, static_cast<size_t>(descriptor_data.size))) {
+		logger()->error("Open blob fail: {}", platform::last_error());
+	} else {
+		opened = true;
+	}
 
-		if(!::WriteFile(m_connection.write_pipe, header.get(), sizeof(ipc::header), &written_bytes, nullptr)) {
-			logger()->error("Write header fail: {}", ::GetLastError());
+	// We have own mapping (or gave up), other side can close its handle
+	write_system_message(SYSTEM_MSG_BLOB_RELEASE, descriptor_data.handle, 0);
+	return opened;
+}
+#pragma endregion LargeMessage
+
+void common::fail_pending_messages()
+{
+	m_pending_send_msgs.take_all([](std::shared_ptr<response_message>& msg) {
+		std::vector<uint8_t> no_response;
+		msg->complete(false, no_response);
+	});
+}
+
+
+bool common::send_response(uint32_t id, bool streamed, std::vector<uint8_t>& response)
+{
+	if(streamed) {
+		// Streamed request answered by one response, it is the only part. It is not limited by stream window
+		// (it is in memory already, as any response), so read thread never wait for credit here.
+		header part_header;
+		part_header.id = id;
+		part_header.flags = HEADER_FLAG_STREAM_DATA;
+		part_header.message_size = static_cast<uint32_t>(response.size());
+		if(!response.empty() && !write_stream_frame(part_header, to_view(response))) {
 			return false;
 		}
+		header end_header;
+		end_header.id = id;
+		end_header.flags = HEADER_FLAG_STREAM_END;
+		return write_stream_frame(end_header, message_view());
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Only WriteFile at the time
+	{
+		std::lock_guard<std::mutex> one_send_guard(m_write_lock);
+		if(!m_comm_running) return false;
 
 		//////////////////////////////////////////////////////////////////////////
-		// Write message
-		if(!::WriteFile(m_connection.write_pipe, response.data(), (DWORD)response.size(), &written_bytes, nullptr)) {
-			logger()->error("Write message fail: {}", ::GetLastError());
+		// Write header + message
+		header header_data;
+		header_data.id = id;
+		header_data.flags = HEADER_FLAG_USER_MSG_RESPONSE;
+		header_data.message_size = static_cast<uint32_t>(response.size());
+
+		message_view part = to_view(response);
+		if(write_message(header_data, message_parts(&part, 1)) != platform::io_result::ok) {
+			logger()->error("Write message fail: {}", platform::last_error());
 			return false;
 		}
 	}
@@ -178,90 +742,260 @@ bool common::send_response(std::shared_ptr<ipc::header> header, std::vector<uint
 #pragma endregion Send
 
 #pragma region Read
-DWORD WINAPI common::read_thread_win_proc(LPVOID lpParameter)
+void common::handle_request(uint32_t id, bool streamed, std::vector<uint8_t> message)
+{
+	released_connection = nullptr;
+	if(m_deferred_callback_fn) {
+		// Callback answer through responder whenever it want
+		m_deferred_callback_fn(message, responder(m_response_channel, id, streamed));
+		if(released_connection != this) {
+			m_buffer_pool->release(message);
+		}
+		return;
+	}
+
+	if(m_coro_callback_fn) {
+		// Start coroutine, it send response once it finish (thread is free while it wait)
+		responder reply(m_response_channel, id, streamed);
+		logger_ptr log = logger();
+		m_coro_callback_fn(std::move(message)).then([reply, log](bool success, std::vector<uint8_t>& response) mutable {
+			if(!success) {
+				log->error("Message coroutine fail, id:{:d}", reply.id());
+			}
+			reply.respond(response);
+		});
+		return;
+	}
+
+	// Call callback and send response (response buffer guess is request size, echo like handlers do not allocate)
+	std::vector<uint8_t> response = m_buffer_pool->acquire(message.size());
+	if(m_view_callback_fn) {
+		m_view_callback_fn(to_view(message), response);
+	} else if(m_callback_fn) {
+		m_callback_fn(message, response);
+	}
+	if(released_connection == this) {
+		return;  // Callback destroyed us (on dispatcher worker), response can not be sent
+	}
+	send_response(id, streamed, response);
+	m_buffer_pool->release(response);
+	m_buffer_pool->release(message);
+}
+
+void common::read_thread()
 {
-	if(!lpParameter) {
-		return 0;
+	reading_connection = this;
+	while(read_message()) {
 	}
-	common* class_ptr = reinterpret_cast<common*>(lpParameter);
-	return class_ptr->read_thread();
+
+	// We must close communication. Most important is write-pipe, because we do not want block other side. Once we close it other side will do the same.
+	close_communication();
 }
 
-DWORD common::read_thread()
+bool common::read_message()
 {
-	DWORD read_bytes = 0;
+	// View callback read payload in place (transport buffer), others get it copied into pooled vector
+	const bool read_views = static_cast<bool>(m_view_callback_fn);
 
-	while(true) {
+	header header_data;
+	std::vector<uint8_t> message;  // Memory from buffer pool
+	message_view message_data;     // Payload (points into message or into transport buffer)
 
-		auto header_data = std::make_unique<header>();
+	//////////////////////////////////////////////////////////////////////////
+	// Read HEADER + MESSAGE
+	platform::io_result result;
+	if(read_views) {
+		result = m_transport->read_frame_view(header_data, message_data);
+	} else {
+		result = m_transport->read_frame(header_data, message);
+		message_data = to_view(message);
+	}
+	if(result == platform::io_result::disconnected) {
+		logger()->info("Pipe disconnected. {:d}", platform::last_error());
+		return false;
+	} else if(result != platform::io_result::ok) {
+		logger()->error("Read pipe fail {:d}", platform::last_error());
+		return false;
+	}
 
-		//////////////////////////////////////////////////////////////////////////
-		// Read HEADER
-		if(!::ReadFile(m_connection.read_pipe, header_data.get(), sizeof(header), &read_bytes, nullptr)) {
-			DWORD last_error = ::GetLastError();
-			if(last_error == ERROR_BROKEN_PIPE || last_error == ERROR_PIPE_NOT_CONNECTED || last_error == ERROR_INVALID_HANDLE) {
-				// ERROR_BROKEN_PIPE write handle closed died
-				// ERROR_PIPE_NOT_CONNECTED master died
-				// ERROR_INVALID_HANDLE close read handle
-				logger()->info("Pipe disconnected. {:d}", last_error);
-				break;
-			} else {
-				logger()->error("Read pipe fail {:d}", last_error);
-				break;
-			}
+	// Large message, payload is in blob mapping (valid until we return)
+	platform::mapped_blob blob;
+	if(header_data.flags & HEADER_FLAG_BLOB) {
+		if(!open_blob(message_data, blob)) {
+			return false;
 		}
+		header_data.flags &= ~HEADER_FLAG_BLOB;
+		header_data.message_size = static_cast<uint32_t>(blob.size());
+		message_data = message_view(reinterpret_cast<const std::byte*>(blob.data()), blob.size());
+		if(!read_views) {
+			// Callbacks want vector
+			m_buffer_pool->release(message);
+			message = m_buffer_pool->acquire(blob.size());
+			message.insert(message.end(), blob.data(), blob.data() + blob.size());
+			message_data = to_view(message);
+		}
+	}
 
-		if(read_bytes != sizeof(header)) {
-			logger()->error("Invalid header size ({:d} != {:d}", read_bytes, sizeof(header));
-			continue;
+	if(logger()->should_log(spdlog::level::debug)) {
+		logger()->debug("Header received id:{:d}, flags:{:x}, message_size:{:d}", header_data.id, header_data.flags, header_data.message_size);
+		logger()->debug("Message received '{}'", std::string(reinterpret_cast<const char*>(message_data.data()), message_data.size()));
+	}
+
+	// Message must outlive this loop (response, dispatcher), copy it out of transport buffer
+	auto own_message = [&]() {
+		if(read_views) {
+			message = m_buffer_pool->acquire(message_data.size());
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(message_data.data());
+			message.insert(message.end(), data, data + message_data.size());
 		}
+	};
 
-		logger()->debug("Header received id:{:d}, flags:{:x}, message_size:{:d}", header_data->id, header_data->flags, header_data->message_size);
-
-		std::vector<uint8_t> message(header_data->message_size);
-		if(header_data->message_size > 0) {
-
-			//////////////////////////////////////////////////////////////////////////
-			// Read MESSAGE
-			read_bytes = 0;
-			if(!::ReadFile(m_connection.read_pipe, message.data(), header_data->message_size, &read_bytes, nullptr)) {
-				DWORD last_error = ::GetLastError();
-				if(last_error == ERROR_BROKEN_PIPE || last_error == ERROR_PIPE_NOT_CONNECTED || last_error == ERROR_INVALID_HANDLE) {
-					// ERROR_BROKEN_PIPE write handle closed died
-					// ERROR_PIPE_NOT_CONNECTED master died
-					// ERROR_INVALID_HANDLE close read handle
-					logger()->info("Pipe disconnected. {:d}", last_error);
-					break;
-				} else {
-					logger()->error("Read pipe fail {:d}", last_error);
-					break;
+	uint32_t flags = header_data.flags;
+	uint32_t message_size = header_data.message_size;
+	// Streamed request is handled as any other (its response is written as stream by send_response)
+	bool streamed = flags == HEADER_FLAG_USER_MSG_STREAMED;
+	bool request = flags == HEADER_FLAG_USER_MSG || streamed;
+
+	if(flags == HEADER_FLAG_SYSTEM_MSG) {
+		on_system_message(message_data);
+	} else if(flags == HEADER_FLAG_USER_MSG_RESPONSE) {
+
+		std::shared_ptr<response_message> msg = m_pending_send_msgs.take(header_data.id);
+		if(msg) {
+			own_message();
+#ifdef __linux__
+			if(reactor_loop_thread) {
+				// Waiter is only woken up here, continuation (user code) run on reactor worker
+				if(!msg->complete_without_callback(true, message)) {
+					m_flow.reactor->post([msg, response = std::move(message)]() mutable {
+						msg->complete(true, response);
+					});
 				}
+			} else
+#endif
+			msg->complete(true, message);
+		}
+	} else if(header_data.flags == HEADER_FLAG_USER_MSG_ONE_WAY) {
+		// Call callback, nobody wait for response
+		if(m_view_callback_fn) {
+			std::vector<uint8_t> response;
+			m_view_callback_fn(message_data, response);
+		} else if(m_deferred_callback_fn) {
+			m_deferred_callback_fn(message, responder());
+		} else if(m_coro_callback_fn) {
+			m_coro_callback_fn(std::move(message));
+		} else if(m_callback_fn) {
+			std::vector<uint8_t> response;
+			m_callback_fn(message, response);
+		}
+	} else if(flags >= HEADER_FLAG_STREAM_OPEN && flags <= HEADER_FLAG_STREAM_ABORT) {
+		// Stream reader keep chunk until it is read (bounded by stream window, not by message credit)
+		own_message();
+		on_stream_frame(header_data, message);
+	} else if(request && m_dispatcher) {
+		// Worker handle it and give back credit, response order does not matter (id match it)
+		own_message();
+		m_dispatcher->post([this, id = header_data.id, streamed, message_size, request = std::move(message)]() mutable {
+			handle_request(id, streamed, std::move(request));
+			if(released_connection != this) {
+				give_back_credit(message_size);
 			}
+		});
+	} else if(request && read_views) {
+		// Callback read payload in place, send response before transport buffer is released
+		std::vector<uint8_t> response = m_buffer_pool->acquire(message_data.size());
+		m_view_callback_fn(message_data, response);
+		send_response(header_data.id, streamed, response);
+		m_buffer_pool->release(response);
+	} else if(request) {
+		handle_request(header_data.id, streamed, std::move(message));
+	}
 
-			logger()->debug("Message received '{}'", std::string(message.begin(), message.end()));
+	// Message is handled (or handed to coroutine / deferred responder), other side can send next one
+	if(flags == HEADER_FLAG_USER_MSG_ONE_WAY || (request && !m_dispatcher)) {
+		give_back_credit(message_size);
+	}
+	if(read_views) {
+		m_transport->release_frame();
+	}
+	m_buffer_pool->release(message);
+	return true;
+}
+
+#ifdef __linux__
+reactor::handler_result common::on_readable(bool may_wait)
+{
+	const common* previous = reading_connection;
+	reading_connection = this;
+	reactor_loop_thread = !may_wait;
+
+	// Worker take the frame loop thread left (and any other which is there whole, it may wait)
+	reactor::handler_result next = reactor::handler_result::rearm;
+	bool running = !may_wait || read_message();
+	while(running) {
+		// Frames already in transport buffer do not wake us up again, take them now
+		header next_header;
+		frame_state state = m_transport->poll_frame(next_header);
+		if(state == frame_state::partial) {
+			break;  // Rest of it wake us up
 		}
+		if(!may_wait && (state == frame_state::unbuffered || runs_callback(next_header))) {
+			next = reactor::handler_result::offload;
+			break;
+		}
+		running = read_message();
+	}
+	reading_connection = previous;
+	reactor_loop_thread = false;
 
-		if(header_data->flags == HEADER_FLAG_USER_MSG_RESPONSE) {
+	if(!running) {
+		close_communication();
+		return reactor::handler_result::remove;
+	}
+	return next;
+}
+#endif
 
-			auto item = m_pending_send_msgs.find(header_data->id);
-			if(item != m_pending_send_msgs.end()) {
-				item->second->set_response(message);
-				::SetEvent(item->second->event());
-			}
-		} else if(header_data->flags == HEADER_FLAG_USER_MSG) {
-			// Call callback and send response
-			std::vector<uint8_t> response;
-			if(m_callback_fn) {
-				m_callback_fn(message, response);
-			}
-			send_response(std::move(header_data), response);
+bool common::runs_callback(const header& header_data) const
+{
+	if(header_data.flags & HEADER_FLAG_BLOB) {
+		return true;  // Not callback, but copy out of blob mapping take long
+	}
+	uint32_t flags = header_data.flags;
+	bool request = flags == HEADER_FLAG_USER_MSG || flags == HEADER_FLAG_USER_MSG_STREAMED;
+	return flags == HEADER_FLAG_USER_MSG_ONE_WAY || (request && !m_dispatcher);
+}
+
+bool common::start_reactor_reads()
+{
+#ifdef __linux__
+	native_handle handle = m_transport->read_handle();
+	if(m_flow.reactor && handle != invalid_handle) {
+		m_reactor_id = m_flow.reactor->add(handle, [this](bool may_wait) {
+			return on_readable(may_wait);
+		});
+		if(!m_reactor_id) {
+			logger()->warn("Reactor does not accept read handle, using read thread");
 		}
 	}
+#endif
+	return m_reactor_id != 0;
+}
 
-	// We must close communication. Most important is write-pipe, because we do not want block other side. Once we close it other side will do the same.
-	close_communication();
+void common::stop_reactor_reads()
+{
+#ifdef __linux__
+	// Wait for running handler (it was woken up by transport)
+	if(m_reactor_id) {
+		m_flow.reactor->remove(m_reactor_id);
+		m_reactor_id = 0;
+	}
+#endif
+}
 
-	return 0;
+bool common::is_reading_thread() const
+{
+	return reading_connection == this;
 }
 #pragma endregion Read
 
@@ -1,43 +1,146 @@
 #pragma once
 
-#include <windows.h>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
 #include "ipc_data.h"
+#include "ipc_transport.h"
+#include "ipc_pending_table.h"
+#include "ipc_dispatcher.h"
+#include "ipc_coro.h"
+#include "ipc_responder.h"
+#include "ipc_stream.h"
+#include "ipc_reactor.h"
 
 namespace ipc {
 
 class common : public logger_holder
 {
 public:
-	common(logger_ptr logger, message_callback_fn callback_fn);
+	common(logger_ptr logger, message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	common(logger_ptr logger, coro_message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	common(logger_ptr logger, deferred_message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	common(logger_ptr logger, view_message_callback_fn callback_fn, const flow_control& flow = flow_control());
 	~common();
 	
-	void start_communication(client_connection& connection);
+	void start_communication(std::unique_ptr<transport> transport);
 	void close_communication();
 
 	bool send(std::vector<uint8_t>& message, std::vector<uint8_t>& response);
+	async_response send_async(const std::vector<uint8_t>& message);
+	async_response send_async(message_parts message);
+	bool post(const std::vector<uint8_t>& message);
+	bool post(message_parts message);
+
+	// Streams (data of any length in chunks, writer wait while reader is behind)
+	std::shared_ptr<stream_writer> open_stream(message_view metadata);
+	std::shared_ptr<stream_reader> accept_stream(uint32_t timeout_ms = platform::wait_infinite);
+	// Request answered by stream of partial responses
+	std::shared_ptr<stream_reader> send_streamed(message_parts message);
+
+	// Hit rate of message buffer pool
+	buffer_pool::statistics buffer_pool_stats();
+
+	// Block until communication ends (stopped or other side disconnected)
+	void wait_for_close();
 
 private:
+	void create_channels();
 	void release();
 
-	bool send_response(std::shared_ptr<ipc::header> header, std::vector<uint8_t>& response);
+	// Stable message is not changed by caller until response arrive (bulk transfer can pass it by reference)
+	async_response send_async(message_parts message, bool stable_message);
+	// streamed: request came by send_streamed, response is written as stream
+	bool send_response(uint32_t id, bool streamed, std::vector<uint8_t>& response);
+
+	// Write frame (m_write_lock must be held), big message go through shared memory blob
+	platform::io_result write_message(header& header_data, message_parts message, bool stable_message = false);
+	// Large messages
+	void release_blob(uint32_t handle);
+	void close_blobs();
+	bool open_blob(message_view descriptor, platform::mapped_blob& blob);
+
+	// Complete all pending messages as failed (communication end)
+	void fail_pending_messages();
 
-	static DWORD WINAPI read_thread_win_proc(LPVOID lpParameter);
-	DWORD read_thread();
+	// Streams
+	uint32_t next_stream_id();
+	// Writer registered for credit (window of other side is waited for)
+	std::shared_ptr<stream_writer> create_stream_writer(uint32_t id);
+	std::shared_ptr<stream_writer> open_response_stream(uint32_t id);
+	bool write_stream_frame(const header& header_data, message_view payload);
+	void on_stream_frame(const header& header_data, std::vector<uint8_t>& message);
+	// Cancel writers and fail readers (communication end)
+	void end_streams();
+
+	// Flow control
+	bool write_system_message(uint32_t type, uint32_t messages, uint32_t bytes);
+	bool acquire_send_credit(uint32_t size);
+	void on_system_message(message_view message);
+	void give_back_credit(uint32_t size);
+
+	// Call message callback and send response (read thread or dispatcher worker)
+	void handle_request(uint32_t id, bool streamed, std::vector<uint8_t> message);
+	void read_thread();
+	// Read and handle one frame (read thread or reactor), false when communication ended
+	bool read_message();
+#ifdef __linux__
+	// Reactor, handle what arrived (loop thread take only whole frames which run no callback)
+	reactor::handler_result on_readable(bool may_wait);
+#endif
+	// Frame run message callback when it is handled (on read thread, reactor leave it to worker)
+	bool runs_callback(const header& header_data) const;
+	bool start_reactor_reads();
+	void stop_reactor_reads();
+	// Caller is the one who read our frames (it must never wait for other side)
+	bool is_reading_thread() const;
 
 private:
 	// common
-	HANDLE m_shutdown_event = nullptr;
-	client_connection m_connection;
+	platform::event m_shutdown_event;
+	std::unique_ptr<transport> m_transport;
 	std::atomic_bool m_comm_running = false;
+	std::shared_ptr<buffer_pool> m_buffer_pool = std::make_shared<buffer_pool>();  // Message buffers and response_message memory
 
 	// write
 	std::mutex m_write_lock;
-	pending_msg_map m_pending_send_msgs;
+	pending_table m_pending_send_msgs;  // Lock-free, senders claim, read thread take
+	std::mutex m_blob_lock;
+	std::vector<native_handle> m_pending_blobs;  // Sent blobs other side did not open yet
+
+	// flow control
+	flow_control m_flow;
+	std::mutex m_credit_lock;
+	std::condition_variable m_credit_changed;
+	bool m_peer_window_known = false;    // Other side announced its window
+	uint32_t m_peer_max_size = 0;        // Biggest message other side accept
+	uint32_t m_credit_messages = 0;      // How many messages we can send
+	uint64_t m_credit_bytes = 0;         // How many bytes we can send
+	uint32_t m_peer_stream_window = 0;   // Bytes we can send into one stream before other side read them
+	std::mutex m_consumed_lock;          // Guards m_consumed_* (read thread and dispatcher workers)
+	uint32_t m_consumed_messages = 0;    // Handled by us, not yet given back
+	uint64_t m_consumed_bytes = 0;
 
 	// read
-	HANDLE m_read_thread = nullptr;
+	std::thread m_read_thread;
+	uint64_t m_reactor_id = 0;                 // Registration in m_flow.reactor, no read thread then
+	std::unique_ptr<dispatcher> m_dispatcher;  // Optional, requests are handled on read thread without it
 	message_callback_fn m_callback_fn = nullptr;
+	coro_message_callback_fn m_coro_callback_fn = nullptr;
+	deferred_message_callback_fn m_deferred_callback_fn = nullptr;
+	view_message_callback_fn m_view_callback_fn = nullptr;
+	std::shared_ptr<response_channel> m_response_channel;  // Shared with responders
+
+	// streams
+	std::shared_ptr<stream_channel> m_stream_channel;  // Shared with stream writers and readers
+	std::atomic<uint32_t> m_next_stream_id = 1;
+	std::mutex m_stream_lock;
+	std::condition_variable m_stream_opened;
+	std::unordered_map<uint32_t, std::weak_ptr<stream_writer>> m_stream_writers;  // Ours, by id (credit, cancel)
+	std::unordered_map<uint32_t, std::weak_ptr<stream_reader>> m_stream_readers;  // Opened by other side, by id
+	std::deque<std::shared_ptr<stream_reader>> m_incoming_streams;                // Opened by other side, not accepted yet
 };
 
 } // end of namespace ipc
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "ipc_data.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Awaitable request, `auto response = co_await master->request(message);`
+// Result is std::nullopt when communication ended before response arrived.
+// Coroutine is resumed on the thread which completed the request (usually read thread),
+// so it must not block there (e.g. by synchronous send).
+class request_awaitable
+{
+public:
+	request_awaitable(async_response pending_response)
+		: m_response(std::move(pending_response))
+	{}
+
+	bool await_ready() const {
+		return m_response.ready();
+	}
+
+	bool await_suspend(std::coroutine_handle<> handle) {
+		// Who comes second (completion or us) decide, completion can run synchronously inside then()
+		m_response.then([this, handle](bool, std::vector<uint8_t>&) {
+			if(m_resume_flag.exchange(true)) {
+				handle.resume();
+			}
+		});
+		return !m_resume_flag.exchange(true);
+	}
+
+	std::optional<std::vector<uint8_t>> await_resume() {
+		std::vector<uint8_t> response;
+		if(!m_response.get(response)) {
+			return std::nullopt;
+		}
+		return response;
+	}
+
+private:
+	async_response m_response;
+	std::atomic_bool m_resume_flag = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Coroutine task (eagerly started), result is delivered to then() callback or to awaiting coroutine.
+// Coroutine frame is destroyed when coroutine finish, task hold only shared result state.
+template<class T>
+class task
+{
+public:
+	using continuation_fn = std::function<void(bool success, T& value)>;
+
+	struct state {
+		std::mutex lock;
+		bool done = false;
+		bool success = false;
+		T value{};
+		std::exception_ptr error;
+		continuation_fn continuation;
+
+		void complete(bool succeeded, T&& result, std::exception_ptr exception) {
+			continuation_fn fn;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				value = std::move(result);
+				error = exception;
+				success = succeeded;
+				done = true;
+				fn = std::move(continuation);
+			}
+			if(fn) {
+				fn(success, value);
+			}
+		}
+
+		void then(continuation_fn fn) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if(!done) {
+					continuation = std::move(fn);
+					return;
+				}
+			}
+			fn(success, value);
+		}
+	};
+
+	struct promise_type {
+		std::shared_ptr<state> m_state = std::make_shared<state>();
+
+		task get_return_object() {
+			return task(m_state);
+		}
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+		void return_value(T value) {
+			m_state->complete(true, std::move(value), nullptr);
+		}
+		void unhandled_exception() {
+			m_state->complete(false, T{}, std::current_exception());
+		}
+	};
+
+	task(std::shared_ptr<state> task_state)
+		: m_state(std::move(task_state))
+	{}
+
+	bool done() const {
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		return m_state->done;
+	}
+
+	// Call fn(success, value) when task finish (immediately in this thread when already finished),
+	// success is false when coroutine ended by exception
+	void then(continuation_fn fn) {
+		m_state->then(std::move(fn));
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Awaitable from other coroutine (exception is re-thrown to awaiting coroutine)
+	struct awaiter {
+		std::shared_ptr<state> m_state;
+		std::atomic_bool m_resume_flag = false;
+
+		bool await_ready() const {
+			std::lock_guard<std::mutex> guard(m_state->lock);
+			return m_state->done;
+		}
+		bool await_suspend(std::coroutine_handle<> handle) {
+			m_state->then([this, handle](bool, T&) {
+				if(m_resume_flag.exchange(true)) {
+					handle.resume();
+				}
+			});
+			return !m_resume_flag.exchange(true);
+		}
+		T await_resume() {
+			if(m_state->error) {
+				std::rethrow_exception(m_state->error);
+			}
+			return std::move(m_state->value);
+		}
+	};
+
+	awaiter operator co_await() const {
+		return awaiter{ m_state };
+	}
+
+private:
+	std::shared_ptr<state> m_state;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Coroutine message callback, message is passed by value (it must live in coroutine frame),
+// response is co_returned. It can co_await requests to the other side without blocking read thread.
+using coro_message_callback_fn = std::function<task<std::vector<uint8_t>>(std::vector<uint8_t> message)>;
+
+} // end of namespace ipc
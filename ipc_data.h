@@ -2,45 +2,108 @@
 
 #include <stdint.h>
 #include <atomic>
-#include <map>
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <string.h>
 #include <vector>
+#include "ipc_platform.h"
+#include "ipc_buffer_pool.h"
 
 namespace ipc {
 
-//////////////////////////////////////////////////////////////////////////
-// Simple unique generator
-namespace message_id {
-
-static std::atomic<uint32_t> g_uniq_id = 0;
-static inline uint32_t new_id() { 
-	return ++g_uniq_id;
-}
-
-} // end of message_id namespace
-//////////////////////////////////////////////////////////////////////////
-
 //////////////////////////////////////////////////////////////////////////
 // Communication header and all around it
 constexpr uint32_t HEADER_FLAG_SYSTEM_MSG        = 0x00;
 constexpr uint32_t HEADER_FLAG_USER_MSG          = 0x01;
 constexpr uint32_t HEADER_FLAG_USER_MSG_RESPONSE = 0x02;
+constexpr uint32_t HEADER_FLAG_USER_MSG_ONE_WAY  = 0x03; // Fire-and-forget, never answered
+constexpr uint32_t HEADER_FLAG_STREAM_OPEN       = 0x04; // Stream started (id is stream id chosen by writer), payload is its metadata
+constexpr uint32_t HEADER_FLAG_STREAM_DATA       = 0x05; // Chunk of stream
+constexpr uint32_t HEADER_FLAG_STREAM_END        = 0x06; // Stream closed by writer, no payload
+constexpr uint32_t HEADER_FLAG_STREAM_ABORT      = 0x07; // Stream aborted by writer, no payload
+constexpr uint32_t HEADER_FLAG_USER_MSG_STREAMED = 0x08; // Request answered by stream of partial responses (id is response stream id)
+constexpr uint32_t HEADER_FLAG_BLOB              = 0x100; // Combined with message kind, payload is blob_descriptor (message is in shared memory)
+
+// Stream id of response stream, it is chosen by requester (other stream ids are chosen by writer)
+constexpr uint32_t STREAM_ID_RESPONSE = 0x80000000;
 
 struct header {
 	uint32_t id = 0;                         // Message has same ID as header
 	uint32_t flags = HEADER_FLAG_SYSTEM_MSG; // Flags
 	uint32_t message_size = 0;               // Following message size (so we know how much we can allocate)
 };
+
+// Large message is not copied through transport, sender put it into shared memory blob and send only this
+struct blob_descriptor {
+	uint64_t size = 0;                       // Message size
+	uint32_t process_id = 0;                 // Sender process, blob handle is valid there
+	uint32_t handle = 0;                     // Blob handle (fd / section handle) in sender process
+};
+//////////////////////////////////////////////////////////////////////////
+
 //////////////////////////////////////////////////////////////////////////
+// System messages (HEADER_FLAG_SYSTEM_MSG payload), flow control
+constexpr uint32_t SYSTEM_MSG_WINDOW = 0x01; // Receive window of sender (initial credit for the other side)
+constexpr uint32_t SYSTEM_MSG_CREDIT = 0x02; // Credit given back after messages were handled
+constexpr uint32_t SYSTEM_MSG_BLOB_RELEASE = 0x03; // Blob was opened, sender can close its handle (handle in messages)
+constexpr uint32_t SYSTEM_MSG_STREAM_WINDOW = 0x04; // Bytes other side can send into one stream before we consume them (bytes)
+constexpr uint32_t SYSTEM_MSG_STREAM_CREDIT = 0x05; // Stream chunks were consumed (stream id in messages, bytes)
+constexpr uint32_t SYSTEM_MSG_STREAM_CANCEL = 0x06; // Reader does not want more stream data (stream id in messages)
+
+struct system_message {
+	uint32_t type = SYSTEM_MSG_WINDOW;
+	uint32_t messages = 0;                   // Number of messages (window / credit)
+	uint32_t bytes = 0;                      // Number of payload bytes (window / credit)
+};
+
+class reactor;
+
+// Flow control of incoming messages (requests and one-way messages, responses are bounded by our requests)
+struct flow_control {
+	uint32_t window_messages = 1024;         // Messages other side can send before it must wait for credit
+	uint32_t window_bytes = 64 * 1024 * 1024;// Payload bytes other side can send before it must wait for credit (also max message size)
+	bool fail_fast = false;                  // Our send fail instead of wait when other side gave no credit
+	uint32_t dispatcher_threads = 0;         // Requests are handled by this many workers (0 = on read thread, in order)
+	uint32_t large_message_threshold = 0;    // Our messages of this size and bigger go through shared memory blob (0 = never)
+	uint32_t bulk_threshold = 0;             // Our synchronously sent messages of this size and bigger are spliced into pipe (0 = never)
+	uint32_t pipe_buffer_size = 0;           // Pipe buffer size (F_SETPIPE_SZ, 0 = system default)
+	uint32_t stream_window_bytes = 4 * 1024 * 1024; // Bytes other side can send into one stream before we read them
+	uint32_t stream_chunk_size = 64 * 1024;  // Our stream data is written in chunks of this size (at most half of other side window)
+	std::shared_ptr<ipc::reactor> reactor;   // Shared event loop read for us instead of own read thread (Linux, pipe and socket transports)
+};
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+// Message without owning vector, gather list of parts is sent as one message
+using message_view = std::span<const std::byte>;
+using message_parts = std::span<const message_view>;
+
+inline message_view to_view(const std::vector<uint8_t>& message) {
+	return std::as_bytes(std::span<const uint8_t>(message));
+}
+//////////////////////////////////////////////////////////////////////////
+
+struct loopback_channel;
 
 struct client_connection {
-	HANDLE read_pipe = nullptr;
-	HANDLE write_pipe = nullptr;
+	native_handle read_pipe = invalid_handle;
+	native_handle write_pipe = invalid_handle;
+	native_handle shared_memory = invalid_handle; // Optional shared memory section (ring buffers instead of pipe I/O)
+	native_handle socket = invalid_handle;        // Optional socket pair end (carry both directions instead of pipes)
+	std::shared_ptr<loopback_channel> loopback;   // Optional in-process queues (master and slave in one process)
+	bool io_uring = false;                        // Drive pipes by io_uring (Linux, plain pipe I/O when it is not available)
 };
 
 //////////////////////////////////////////////////////////////////////////
 
 using message_callback_fn = std::function<void(const std::vector<uint8_t>& message, std::vector<uint8_t>& response)>;
+// Message is read in place from transport receive buffer (no copy), view is valid only until callback returns
+using view_message_callback_fn = std::function<void(message_view message, std::vector<uint8_t>& response)>;
+// Called when response of asynchronously sent message arrives (success == false when communication ended before)
+using response_callback_fn = std::function<void(bool success, std::vector<uint8_t>& response)>;
 
 //////////////////////////////////////////////////////////////////////////
 // Message
@@ -53,6 +116,9 @@ public:
 	uint32_t id() const {
 		return m_id;
 	}
+	void set_id(uint32_t id) {
+		m_id = id;
+	}
 private:
 	uint32_t m_id = 0;
 };
@@ -60,36 +126,145 @@ private:
 class response_message : public message
 {
 public:
-	response_message(uint32_t id)
+	response_message(uint32_t id, std::shared_ptr<buffer_pool> pool = nullptr)
 		: message(id)
+		, m_wait(platform::wait_pool::global().acquire())
+		, m_buffer_pool(std::move(pool))
 	{
-		m_event = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		if(m_event) {
-			std::exception("Create event fail");
-		}
 	}
 	~response_message() {
-		::CloseHandle(m_event);
-		m_event = nullptr;
+		platform::wait_pool::global().release(m_wait);
+		if(m_buffer_pool) {
+			m_buffer_pool->release(m_response_buffer);
+		}
 	}
 
-	HANDLE event() const {
-		return m_event;
+	response_message(const response_message&) = delete;
+	response_message& operator=(const response_message&) = delete;
+
+	// Wait until message is completed, return false on timeout
+	bool wait(uint32_t timeout_ms) {
+		return m_wait->wait(timeout_ms);
 	}
-	std::vector<uint8_t> response_buffer() const {
+	std::vector<uint8_t>& response() {
 		return m_response_buffer;
 	}
 
-	void set_response(std::vector<uint8_t>& data) {
-		m_response_buffer = std::move(data);
+	bool completed() const {
+		return m_completed;
+	}
+	bool success() const {
+		return m_success;
+	}
+
+	// Store response (or failure), signal event and call completion callback, only first call count
+	void complete(bool success, std::vector<uint8_t>& data) {
+		response_callback_fn callback;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if(m_completed) return;
+			m_response_buffer = std::move(data);
+			m_success = success;
+			m_completed = true;
+			callback = std::move(m_callback);
+		}
+		m_wait->set();
+		if(callback) {
+			callback(m_success, m_response_buffer);
+		}
+	}
+
+	// Complete it only when no callback is set (nobody's code run here), false when caller has to call complete()
+	bool complete_without_callback(bool success, std::vector<uint8_t>& data) {
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if(m_callback) return false;
+			if(m_completed) return true;
+			m_response_buffer = std::move(data);
+			m_success = success;
+			m_completed = true;
+		}
+		m_wait->set();
+		return true;
+	}
+
+	// Call fn when message complete (immediately in this thread when already completed)
+	void then(response_callback_fn fn) {
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if(!m_completed) {
+				m_callback = std::move(fn);
+				return;
+			}
+		}
+		fn(m_success, m_response_buffer);
 	}
 
 private:
-	uint32_t m_id = 0;
-	HANDLE m_event = nullptr;
+	platform::wait_slot* m_wait = nullptr; // From pool, set once message is completed
+	std::shared_ptr<buffer_pool> m_buffer_pool; // Response buffer go back there
 	std::vector<uint8_t> m_response_buffer;
+
+	std::mutex m_lock;
+	std::atomic_bool m_completed = false;
+	bool m_success = false;
+	response_callback_fn m_callback;
 };
 
-typedef std::map<uint32_t, std::shared_ptr<response_message>> pending_msg_map;
+//////////////////////////////////////////////////////////////////////////
+// Handle of asynchronously sent message (future like)
+class async_response
+{
+public:
+	async_response() = default;
+	async_response(std::shared_ptr<response_message> msg)
+		: m_msg(std::move(msg))
+	{}
+
+	bool valid() const {
+		return m_msg != nullptr;
+	}
+	bool ready() const {
+		return m_msg && m_msg->completed();
+	}
+
+	// Wait for completion, return false on timeout
+	bool wait(uint32_t timeout_ms = platform::wait_infinite) {
+		if(!m_msg) return false;
+		if(m_msg->completed()) return true;
+		return m_msg->wait(timeout_ms);
+	}
+
+	// Wait for completion and move response out, return false when communication ended before response arrived
+	bool get(std::vector<uint8_t>& response) {
+		if(!wait() || !m_msg->success()) return false;
+		// Swap, so previous caller buffer is recycled with message (and not freed)
+		response.swap(m_msg->response());
+		return true;
+	}
+
+	// Wait for completion and copy response into caller buffer, response_size is set to response size
+	// (false also when buffer is too small, nothing is copied then)
+	bool get(std::span<std::byte> response, size_t& response_size) {
+		response_size = 0;
+		if(!wait() || !m_msg->success()) return false;
+		const std::vector<uint8_t>& data = m_msg->response();
+		response_size = data.size();
+		if(data.size() > response.size()) return false;
+		if(!data.empty()) {
+			::memcpy(response.data(), data.data(), data.size());
+		}
+		return true;
+	}
+
+	// Call fn(success, response) on completion, it runs on read thread (or in this thread when already completed),
+	// so it must not block (e.g. by synchronous send)
+	void then(response_callback_fn fn) {
+		if(m_msg) m_msg->then(std::move(fn));
+	}
+
+private:
+	std::shared_ptr<response_message> m_msg;
+};
 
 } // end of namespace ipc
\ No newline at end of file
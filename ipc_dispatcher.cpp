@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "ipc_dispatcher.h"
+
+namespace ipc {
+
+dispatcher::dispatcher(uint32_t workers)
+	: m_state(std::make_shared<shared_state>())
+{
+	if(workers == 0) {
+		workers = 1;
+	}
+	for(uint32_t i = 0; i < workers; i++) {
+		m_state->queues.push_back(std::make_unique<work_queue>());
+	}
+	for(uint32_t i = 0; i < workers; i++) {
+		m_workers.emplace_back(&dispatcher::worker_thread, m_state, i);
+	}
+}
+
+dispatcher::~dispatcher()
+{
+	stop();
+}
+
+void dispatcher::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_state->idle_lock);
+		m_state->stop = true;
+	}
+	m_state->idle_changed.notify_all();
+
+	for(auto& worker : m_workers) {
+		if(!worker.joinable()) {
+			continue;
+		}
+		if(worker.get_id() == std::this_thread::get_id()) {
+			worker.detach();  // Can not join itself, it hold shared state until its work return
+		} else {
+			worker.join();
+		}
+	}
+}
+
+void dispatcher::post(work_fn fn)
+{
+	shared_state& state = *m_state;
+	work_queue& queue = *state.queues[state.next_queue.fetch_add(1, std::memory_order_relaxed) % state.queues.size()];
+	{
+		std::lock_guard<std::mutex> guard(queue.lock);
+		queue.items.push_back(std::move(fn));
+	}
+
+	// Count under idle lock, so worker can not miss it between check and sleep
+	std::lock_guard<std::mutex> guard(state.idle_lock);
+	state.queued++;
+	if(state.sleeping) {
+		state.idle_changed.notify_one();
+	}
+}
+
+bool dispatcher::shared_state::try_take(uint32_t index, work_fn& fn)
+{
+	// Own queue first (oldest work), then steal newest work of others
+	for(size_t i = 0; i < queues.size(); i++) {
+		work_queue& queue = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if(queue.items.empty()) {
+			continue;
+		}
+		if(i == 0) {
+			fn = std::move(queue.items.front());
+			queue.items.pop_front();
+		} else {
+			fn = std::move(queue.items.back());
+			queue.items.pop_back();
+		}
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void dispatcher::worker_thread(std::shared_ptr<shared_state> state, uint32_t index)
+{
+	// Stopped dispatcher does not start queued work (it may refer to connection which is gone)
+	while(!state->stop.load(std::memory_order_relaxed)) {
+		work_fn fn;
+		if(state->try_take(index, fn)) {
+			fn();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> guard(state->idle_lock);
+		if(state->stop) {
+			break;
+		}
+		if(state->queued == 0) {
+			state->sleeping++;
+			state->idle_changed.wait(guard, [&]() { return state->stop || state->queued != 0; });
+			state->sleeping--;
+		}
+	}
+}
+
+} // end of namespace ipc
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Work-stealing executor for incoming requests.
+// Every worker has own queue, posted work is spread round-robin, idle worker
+// take work from its queue front and steal from back of other queues.
+class dispatcher
+{
+public:
+	using work_fn = std::function<void()>;
+
+	dispatcher(uint32_t workers);
+	~dispatcher();
+
+	dispatcher(const dispatcher&) = delete;
+	dispatcher& operator=(const dispatcher&) = delete;
+
+	void post(work_fn fn);
+	// Stop and join workers, not started work is dropped. Worker calling it (work which end connection) is
+	// detached instead, it exit once its work return, so dispatcher can be destroyed from it
+	void stop();
+
+private:
+	struct alignas(64) work_queue {
+		std::mutex lock;
+		std::deque<work_fn> items;
+	};
+
+	// Owned also by workers, detached one use it after dispatcher is gone
+	struct shared_state {
+		std::vector<std::unique_ptr<work_queue>> queues;
+		std::atomic<uint32_t> next_queue = 0;
+		std::atomic<size_t> queued = 0;
+
+		std::mutex idle_lock;
+		std::condition_variable idle_changed;
+		uint32_t sleeping = 0;          // Guarded by idle_lock
+		std::atomic_bool stop = false;  // Changed under idle_lock
+
+		bool try_take(uint32_t index, work_fn& fn);
+	};
+
+	static void worker_thread(std::shared_ptr<shared_state> state, uint32_t index);
+
+private:
+	std::shared_ptr<shared_state> m_state;
+	std::vector<std::thread> m_workers;
+};
+
+} // end of namespace ipc
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "ipc_loopback_transport.h"
+
+namespace ipc {
+
+#pragma region Queue
+platform::io_result loopback_queue::push(const header& header_data, std::vector<uint8_t>& payload)
+{
+	while(!has_space()) {
+		m_producer_waiting.store(1);
+		if(has_space()) {
+			m_producer_waiting.store(0);
+			break;
+		}
+		if(m_read_closed.load()) {
+			return platform::io_result::disconnected;
+		}
+		m_producer_waiting.wait(1);
+	}
+	if(m_read_closed.load() || m_write_closed.load()) {
+		return platform::io_result::disconnected;
+	}
+
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	frame& slot = m_frames[head & (capacity - 1)];
+	slot.header_data = header_data;
+	slot.payload.swap(payload);
+	m_head.store(head + 1);
+	wake_if_waiting(m_consumer_waiting);
+	return platform::io_result::ok;
+}
+
+platform::io_result loopback_queue::pop(header& header_data, std::vector<uint8_t>& payload)
+{
+	while(!has_data()) {
+		if(m_write_closed.load()) {
+			// Producer push everything before it close queue
+			if(has_data()) {
+				break;
+			}
+			return platform::io_result::disconnected;
+		}
+		if(m_woken.load()) {
+			return platform::io_result::disconnected;
+		}
+		m_consumer_waiting.store(1);
+		if(has_data() || m_write_closed.load() || m_woken.load()) {
+			m_consumer_waiting.store(0);
+			continue;
+		}
+		m_consumer_waiting.wait(1);
+	}
+
+	uint64_t tail = m_tail.load(std::memory_order_relaxed);
+	frame& slot = m_frames[tail & (capacity - 1)];
+	header_data = slot.header_data;
+	payload.swap(slot.payload);
+	m_tail.store(tail + 1);
+	wake_if_waiting(m_producer_waiting);
+	return platform::io_result::ok;
+}
+
+void loopback_queue::close_write()
+{
+	m_write_closed.store(true);
+	m_consumer_waiting.store(0);
+	m_consumer_waiting.notify_all();
+}
+
+void loopback_queue::close_read()
+{
+	m_read_closed.store(true);
+	m_producer_waiting.store(0);
+	m_producer_waiting.notify_all();
+}
+
+void loopback_queue::wakeup()
+{
+	// Waiting word is cleared before notify, so consumer which is just going to sleep does not sleep
+	m_woken.store(true);
+	m_consumer_waiting.store(0);
+	m_consumer_waiting.notify_all();
+}
+
+void loopback_queue::wake_if_waiting(std::atomic<uint32_t>& waiting)
+{
+	if(waiting.load() != 0 && waiting.exchange(0) != 0) {
+		waiting.notify_one();
+	}
+}
+#pragma endregion Queue
+
+#pragma region Transport
+loopback_transport::loopback_transport(client_connection& connection, bool master_side)
+	: m_channel(std::move(connection.loopback))
+{
+	m_write_queue = master_side ? &m_channel->to_slave : &m_channel->to_master;
+	m_read_queue = master_side ? &m_channel->to_master : &m_channel->to_slave;
+}
+
+loopback_transport::~loopback_transport()
+{
+	close_write();
+	close_read();
+}
+
+platform::io_result loopback_transport::write_frame(const header& header_data, message_parts parts)
+{
+	// Parts are copied into pool buffer which is moved to reader (its pool get it back)
+	std::vector<uint8_t> payload;
+	if(header_data.message_size) {
+		prepare_payload(payload, header_data.message_size);
+		for(const message_view& part : parts) {
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(part.data());
+			payload.insert(payload.end(), data, data + part.size());
+		}
+	}
+	platform::io_result result = m_write_queue->push(header_data, payload);
+	if(result != platform::io_result::ok && m_buffer_pool && payload.capacity()) {
+		// Reader is gone, buffer was not queued
+		m_buffer_pool->release(payload);
+	}
+	return result;
+}
+
+platform::io_result loopback_transport::read_frame(header& header_data, std::vector<uint8_t>& payload)
+{
+	// Caller buffer is recycled, queued one is taken
+	if(m_buffer_pool && payload.capacity()) {
+		m_buffer_pool->release(payload);
+	}
+	platform::io_result result = m_read_queue->pop(header_data, payload);
+	if(result == platform::io_result::ok && header_data.message_size > m_max_message_size) {
+		return platform::io_result::failed;
+	}
+	return result;
+}
+
+void loopback_transport::close_write()
+{
+	m_write_queue->close_write();
+}
+
+void loopback_transport::close_read()
+{
+	m_read_queue->close_read();
+}
+
+void loopback_transport::wakeup()
+{
+	m_read_queue->wakeup();
+}
+#pragma endregion Transport
+
+} // end of namespace ipc
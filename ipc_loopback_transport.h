@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include "ipc_transport.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Single-producer/single-consumer bounded queue of frames (producer is serialized by common::m_write_lock,
+// consumer is read thread). Slot payload buffer is moved in and swapped out, so frame is copied only once
+// (from message parts into pool buffer). Sleeping side is notified only when it announced it waits.
+class loopback_queue
+{
+public:
+	static constexpr uint64_t capacity = 1024; // Must be power of two
+
+	loopback_queue() = default;
+	loopback_queue(const loopback_queue&) = delete;
+	loopback_queue& operator=(const loopback_queue&) = delete;
+
+	// Producer side, payload is moved in, wait while queue is full (disconnected when consumer closed queue)
+	platform::io_result push(const header& header_data, std::vector<uint8_t>& payload);
+	// Consumer side, payload is swapped with queued one, wait while queue is empty
+	// (disconnected when producer closed queue and everything was read, or consumer was woken up)
+	platform::io_result pop(header& header_data, std::vector<uint8_t>& payload);
+
+	// Producer will not push anymore
+	void close_write();
+	// Consumer will not pop anymore (queued frames are dropped)
+	void close_read();
+	// Abort waiting pop (also every next one)
+	void wakeup();
+
+private:
+	struct frame {
+		header header_data;
+		std::vector<uint8_t> payload;
+	};
+
+	bool has_data() const {
+		return m_head.load() != m_tail.load(std::memory_order_relaxed);
+	}
+	bool has_space() const {
+		return m_head.load(std::memory_order_relaxed) - m_tail.load() < capacity;
+	}
+	static void wake_if_waiting(std::atomic<uint32_t>& waiting);
+
+private:
+	std::array<frame, capacity> m_frames;
+	alignas(64) std::atomic<uint64_t> m_head = 0;  // Frames pushed
+	alignas(64) std::atomic<uint64_t> m_tail = 0;  // Frames popped
+	alignas(64) std::atomic<uint32_t> m_consumer_waiting = 0;
+	std::atomic<uint32_t> m_producer_waiting = 0;
+	std::atomic<bool> m_write_closed = false;
+	std::atomic<bool> m_read_closed = false;
+	std::atomic<bool> m_woken = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Both directions of in-process connection (master and slave objects in one process)
+struct loopback_channel {
+	loopback_queue to_slave;
+	loopback_queue to_master;
+	// Frame buffers are taken from writer pool and released into reader pool, one pool keep both balanced
+	// (pool of side which get more frames, credits of other side, would only grow)
+	std::shared_ptr<buffer_pool> buffers = std::make_shared<buffer_pool>();
+};
+
+//////////////////////////////////////////////////////////////////////////
+// In-process transport, frames go through lock-free queues instead of kernel (no syscall while both sides
+// are busy), so benchmark measure protocol overhead only
+class loopback_transport : public transport
+{
+public:
+	loopback_transport(client_connection& connection, bool master_side);
+	~loopback_transport();
+
+	//! \copydoc transport::write_frame
+	platform::io_result write_frame(const header& header_data, message_parts parts) override;
+	using transport::write_frame;
+	//! \copydoc transport::read_frame
+	platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+	//! \copydoc transport::wakeup
+	void wakeup() override;
+	//! \copydoc transport::shared_buffer_pool
+	std::shared_ptr<buffer_pool> shared_buffer_pool() const override {
+		return m_channel->buffers;
+	}
+
+private:
+	std::shared_ptr<loopback_channel> m_channel;
+	loopback_queue* m_write_queue = nullptr;
+	loopback_queue* m_read_queue = nullptr;
+};
+
+} // end of namespace ipc
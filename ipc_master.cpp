@@ -5,18 +5,62 @@
 #include <iostream>
 #include <string>
 #include "convert.h"
+#include "ipc_shm_transport.h"
+#include "ipc_socket_transport.h"
+#include "ipc_seqpacket_transport.h"
+#include "ipc_loopback_transport.h"
 
 namespace ipc {
 
-std::shared_ptr<master_intf> master::factory::create_master(logger_ptr logger, message_callback_fn callback_fn) const
+std::shared_ptr<master_intf> master::factory::create_master(logger_ptr logger, message_callback_fn callback_fn, transport_type type, const flow_control& flow) const
 {
-	std::shared_ptr<master> impl = std::make_shared<master>(logger, callback_fn);
+	std::shared_ptr<master> impl = std::make_shared<master>(logger, callback_fn, type, flow);
 	impl->initialize();
 	return impl;
 }
 
-master::master(logger_ptr logger, message_callback_fn callback_fn)
-	: common(logger, callback_fn)
+std::shared_ptr<master_intf> master::factory::create_master(logger_ptr logger, coro_message_callback_fn callback_fn, transport_type type, const flow_control& flow) const
+{
+	std::shared_ptr<master> impl = std::make_shared<master>(logger, callback_fn, type, flow);
+	impl->initialize();
+	return impl;
+}
+
+std::shared_ptr<master_intf> master::factory::create_master(logger_ptr logger, deferred_message_callback_fn callback_fn, transport_type type, const flow_control& flow) const
+{
+	std::shared_ptr<master> impl = std::make_shared<master>(logger, callback_fn, type, flow);
+	impl->initialize();
+	return impl;
+}
+
+std::shared_ptr<master_intf> master::factory::create_master(logger_ptr logger, view_message_callback_fn callback_fn, transport_type type, const flow_control& flow) const
+{
+	std::shared_ptr<master> impl = std::make_shared<master>(logger, callback_fn, type, flow);
+	impl->initialize();
+	return impl;
+}
+
+master::master(logger_ptr logger, message_callback_fn callback_fn, transport_type type, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+	, m_transport_type(type)
+{
+}
+
+master::master(logger_ptr logger, coro_message_callback_fn callback_fn, transport_type type, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+	, m_transport_type(type)
+{
+}
+
+master::master(logger_ptr logger, deferred_message_callback_fn callback_fn, transport_type type, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+	, m_transport_type(type)
+{
+}
+
+master::master(logger_ptr logger, view_message_callback_fn callback_fn, transport_type type, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+	, m_transport_type(type)
 {
 }
 
@@ -34,31 +78,68 @@ void master::initialize()
 		release();
 	};
 
-	// Set the bInheritHandle flag so pipe handles are inherited.
-	SECURITY_ATTRIBUTES saAttr;
-	saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
-	saAttr.bInheritHandle = TRUE;
-	saAttr.lpSecurityDescriptor = NULL;
+	// One socket pair carry both directions, no pipes then
+	if(m_transport_type == transport_type::socket) {
+#ifndef _WIN32
+		if(!socket_transport::create_pair(m_master.socket, m_slave.socket)) {
+			throw std::runtime_error("Create socket pair fail: " + platform::error_to_ansi(platform::last_error()));
+		}
+#else
+		logger()->warn("Socket transport is not supported on this platform, using pipes");
+#endif
+	}
+	if(m_transport_type == transport_type::seqpacket) {
+#ifdef __linux__
+		if(!seqpacket_transport::create_pair(m_master.socket, m_slave.socket)) {
+			throw std::runtime_error("Create socket pair fail: " + platform::error_to_ansi(platform::last_error()));
+		}
+#else
+		logger()->warn("Seqpacket transport is not supported on this platform, using pipes");
+#endif
+	}
 
-	// Create Master->Slave direction (master write, slave read)
-	if(!::CreatePipe(&m_slave.read_pipe, &m_master.write_pipe, &saAttr, 0)) {
-		std::exception("Create pipe fail");
+	// Both ends in this process, queues instead of kernel objects
+	if(m_transport_type == transport_type::loopback) {
+		m_master.loopback = std::make_shared<loopback_channel>();
+		m_slave.loopback = m_master.loopback;
 	}
-	// Ensure the master-write handle to the pipe is not inherited.
-	if(!::SetHandleInformation(m_master.write_pipe, HANDLE_FLAG_INHERIT, 0)) {
-		std::exception("SetHandleInformation fail");
+
+	if(m_master.socket == invalid_handle && !m_master.loopback) {
+		// Create Master->Slave direction (master write, slave read)
+		// Ensure the master-write handle to the pipe is not inherited.
+		if(!platform::create_pipe(m_slave.read_pipe, m_master.write_pipe, true, false)) {
+			throw std::runtime_error("Create pipe fail: " + platform::error_to_ansi(platform::last_error()));
+		}
+
+		// Create Master<-Slave direction (Slave write, master read)
+		// Ensure the master-read handle to the pipe is not inherited. 
+		if(!platform::create_pipe(m_master.read_pipe, m_slave.write_pipe, false, true)) {
+			throw std::runtime_error("Create pipe fail: " + platform::error_to_ansi(platform::last_error()));
+		}
 	}
 
-	// Create Master<-Slave direction (Slave write, master read)
-	if(!::CreatePipe(&m_master.read_pipe, &m_slave.write_pipe, &saAttr, 0)) {
-		std::exception("Create pipe fail");
+	// Same pipes, each side drive them by io_uring (or fall back to plain I/O on its own)
+	if(m_transport_type == transport_type::io_uring) {
+#ifdef __linux__
+		m_master.io_uring = true;
+		m_slave.io_uring = true;
+#else
+		logger()->warn("io_uring transport is not supported on this platform, using pipes");
+#endif
 	}
-	// Ensure the master-read handle to the pipe is not inherited. 
-	if(!::SetHandleInformation(m_master.read_pipe, HANDLE_FLAG_INHERIT, 0)) {
-		std::exception("SetHandleInformation fail");
+
+	// Shared memory rings for data, pipes stay open only to detect end of the other side
+	if(m_transport_type == transport_type::shared_memory) {
+#ifdef __linux__
+		if(!shm_transport::create_section(m_master.shared_memory, m_slave.shared_memory)) {
+			throw std::runtime_error("Create shared memory fail: " + platform::error_to_ansi(platform::last_error()));
+		}
+#else
+		logger()->warn("Shared memory transport is not supported on this platform, using pipes");
+#endif
 	}
 
-	logger()->debug("Handles (slave):{:x}{:x}, (master):{:x}{:x}", m_slave.read_pipe, m_slave.write_pipe, m_master.read_pipe, m_master.write_pipe);
+	logger()->debug("Handles (slave):{:x}{:x}{:x}, (master):{:x}{:x}{:x}", m_slave.read_pipe, m_slave.write_pipe, m_slave.socket, m_master.read_pipe, m_master.write_pipe, m_master.socket);
 
 	// All create OK, do not call guard on exit
 	file_guard.dismiss();
@@ -66,22 +147,16 @@ void master::initialize()
 
 void master::release()
 {
-	if(m_master.read_pipe) {
-		::CloseHandle(m_master.read_pipe);
-		m_master.read_pipe = nullptr;
-	}
-	if(m_master.write_pipe) {
-		::CloseHandle(m_master.write_pipe);
-		m_master.write_pipe = nullptr;
-	}
-	if(m_slave.read_pipe) {
-		::CloseHandle(m_slave.read_pipe);
-		m_slave.read_pipe = nullptr;
-	}
-	if(m_slave.write_pipe) {
-		::CloseHandle(m_slave.write_pipe);
-		m_slave.write_pipe = nullptr;
-	}
+	platform::close_handle(m_master.read_pipe);
+	platform::close_handle(m_master.write_pipe);
+	platform::close_handle(m_slave.read_pipe);
+	platform::close_handle(m_slave.write_pipe);
+	platform::close_handle(m_master.shared_memory);
+	platform::close_handle(m_slave.shared_memory);
+	platform::close_handle(m_master.socket);
+	platform::close_handle(m_slave.socket);
+	m_master.loopback.reset();
+	m_slave.loopback.reset();
 }
 
 void master::stop()
@@ -92,18 +167,14 @@ void master::stop()
 void master::start()
 {
 	// Close slave pipes, so we are able detect end of the slave process (ReadFile will end with ERROR_INVALID_HANDLE)
-	if(m_slave.read_pipe) {
-		::CloseHandle(m_slave.read_pipe);
-		m_slave.read_pipe = nullptr;
-	}
-	if(m_slave.write_pipe) {
-		::CloseHandle(m_slave.write_pipe);
-		m_slave.write_pipe = nullptr;
-	}
-	start_communication(m_master);
-	// After start clear our connection we held, common now hold this for us, and we do not want release it multile times
-	m_master.read_pipe = nullptr;
-	m_master.write_pipe = nullptr;
+	platform::close_handle(m_slave.read_pipe);
+	platform::close_handle(m_slave.write_pipe);
+	platform::close_handle(m_slave.shared_memory);
+	platform::close_handle(m_slave.socket);
+	m_slave.loopback.reset();
+	// Transport take handles from our connection, common now hold this for us, and we do not want release it multile times
+	transport::factory transport_factory;
+	start_communication(transport_factory.create_transport(m_master, true));
 }
 
 bool master::send(std::vector<uint8_t>& message, std::vector<uint8_t>& response)
@@ -111,11 +182,79 @@ bool master::send(std::vector<uint8_t>& message, std::vector<uint8_t>& response)
 	return common::send(message, response);
 }
 
+async_response master::send_async(const std::vector<uint8_t>& message)
+{
+	return common::send_async(message);
+}
+
+bool master::post(const std::vector<uint8_t>& message)
+{
+	return common::post(message);
+}
+
+async_response master::send_async(message_parts message)
+{
+	return common::send_async(message);
+}
+
+bool master::post(message_parts message)
+{
+	return common::post(message);
+}
+
+std::shared_ptr<stream_writer> master::open_stream(message_view metadata)
+{
+	return common::open_stream(metadata);
+}
+
+std::shared_ptr<stream_reader> master::accept_stream(uint32_t timeout_ms)
+{
+	return common::accept_stream(timeout_ms);
+}
+
+std::shared_ptr<stream_reader> master::send_streamed(message_parts message)
+{
+	return common::send_streamed(message);
+}
+
+buffer_pool::statistics master::buffer_pool_stats()
+{
+	return common::buffer_pool_stats();
+}
+
+client_connection master::take_slave_connection()
+{
+	// Slave own the handles now, we must not close them
+	client_connection connection = m_slave;
+	m_slave = client_connection();
+	return connection;
+}
+
 std::wstring master::cmd_pipe_params()
 {
 	std::wstringstream cmd_param;
+	if(m_slave.loopback) {
+		// Loopback can not be passed to other process (see take_slave_connection)
+		cmd_param << L"/pipe-slave";
+		return cmd_param.str();
+	}
+#ifdef _WIN32
 	// Because PIPE "IDs" are HEXa numbers we must pass HEXa number (so slave can open (find) the PIPE)
 	cmd_param << L"/pipe-slave" << L" " << L"/pipe-r=" << std::hex << reinterpret_cast<std::size_t>(m_slave.read_pipe) << L" /pipe-w=" << std::hex << reinterpret_cast<std::size_t>(m_slave.write_pipe);
+#else
+	// File descriptors are inherited by exec, pass them as decimal numbers
+	if(m_slave.socket != invalid_handle) {
+		cmd_param << L"/pipe-slave" << L" " << L"/sock=" << m_slave.socket;
+		return cmd_param.str();
+	}
+	cmd_param << L"/pipe-slave" << L" " << L"/pipe-r=" << m_slave.read_pipe << L" /pipe-w=" << m_slave.write_pipe;
+	if(m_slave.shared_memory != invalid_handle) {
+		cmd_param << L" /shm=" << m_slave.shared_memory;
+	}
+	if(m_slave.io_uring) {
+		cmd_param << L" /uring";
+	}
+#endif
 	return cmd_param.str();
 }
 
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <windows.h>
 #include "ipc_data.h"
 #include "ipc_master_intf.h"
 #include "ipc_common.h"
@@ -12,11 +11,17 @@ class master
 	, protected common
 {
 public:
-	master(logger_ptr logger, message_callback_fn callback_fn);
+	master(logger_ptr logger, message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control());
+	master(logger_ptr logger, coro_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control());
+	master(logger_ptr logger, deferred_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control());
+	master(logger_ptr logger, view_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control());
 	~master();
 
 	struct factory {
-		virtual std::shared_ptr<master_intf> create_master(logger_ptr logger, message_callback_fn callback_fn) const;
+		virtual std::shared_ptr<master_intf> create_master(logger_ptr logger, message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<master_intf> create_master(logger_ptr logger, coro_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<master_intf> create_master(logger_ptr logger, deferred_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<master_intf> create_master(logger_ptr logger, view_message_callback_fn callback_fn, transport_type type = default_transport, const flow_control& flow = flow_control()) const;
 	};
 
 	//! \copydoc master_intf::start
@@ -25,8 +30,30 @@ public:
 	void stop() override;
 	//! \copydoc master_intf::send
 	bool send(std::vector<uint8_t>& message, std::vector<uint8_t>& response) override;
+	//! \copydoc master_intf::send_async
+	async_response send_async(const std::vector<uint8_t>& message) override;
+	//! \copydoc master_intf::post
+	bool post(const std::vector<uint8_t>& message) override;
+	//! \copydoc master_intf::send_async(message_parts)
+	async_response send_async(message_parts message) override;
+	//! \copydoc master_intf::post(message_parts)
+	bool post(message_parts message) override;
+	using master_intf::send;
+	using master_intf::send_async;
+	using master_intf::post;
+	//! \copydoc master_intf::open_stream
+	std::shared_ptr<stream_writer> open_stream(message_view metadata) override;
+	//! \copydoc master_intf::accept_stream
+	std::shared_ptr<stream_reader> accept_stream(uint32_t timeout_ms = platform::wait_infinite) override;
+	//! \copydoc master_intf::send_streamed(message_parts)
+	std::shared_ptr<stream_reader> send_streamed(message_parts message) override;
+	using master_intf::send_streamed;
+	//! \copydoc master_intf::buffer_pool_stats
+	buffer_pool::statistics buffer_pool_stats() override;
 	//! \copydoc master_intf::cmd_pipe_params
 	std::wstring cmd_pipe_params() override;
+	//! \copydoc master_intf::take_slave_connection
+	client_connection take_slave_connection() override;
 
 private:
 
@@ -35,6 +62,7 @@ private:
 
 private:
 	std::atomic_bool m_comm_started = false;
+	transport_type m_transport_type = default_transport;
 
 	client_connection m_master;
 	client_connection m_slave;
@@ -0,0 +1,67 @@
+#include "stdafx.h"
+#include "ipc_pending_table.h"
+#include <stdexcept>
+
+namespace ipc {
+
+pending_table::pending_table(uint32_t capacity)
+	: m_capacity(capacity)
+	, m_index_mask(capacity - 1)
+{
+	if(capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity > (1u << 24)) {
+		throw std::invalid_argument("Pending table capacity must be power of two");
+	}
+	while((1u << m_index_bits) < capacity) {
+		m_index_bits++;
+	}
+
+	m_slots = std::make_unique<slot[]>(capacity);
+	for(uint32_t i = 0; i < capacity; i++) {
+		// First generation is 1, so no message id is 0
+		m_slots[i].state.store(make_state((1u << m_index_bits) | i, slot_free));
+	}
+}
+
+uint32_t pending_table::next_id(uint32_t id) const
+{
+	uint32_t next = id + (1u << m_index_bits);
+	if(next & STREAM_ID_RESPONSE) {
+		// Generation wrap below top bit (it mark response streams), generation 0 is skipped
+		next = (1u << m_index_bits) | (id & m_index_mask);
+	}
+	return next;
+}
+
+uint32_t pending_table::claim(std::shared_ptr<response_message> msg)
+{
+	uint32_t start = m_claim_hint.fetch_add(1, std::memory_order_relaxed);
+	for(uint32_t i = 0; i < m_capacity; i++) {
+		slot& item = m_slots[(start + i) & m_index_mask];
+		uint64_t state = item.state.load(std::memory_order_acquire);
+		if(status(state) != slot_free) {
+			continue;
+		}
+		uint32_t id = slot_id(state);
+		if(!item.state.compare_exchange_strong(state, make_state(id, slot_claiming), std::memory_order_acq_rel)) {
+			continue;
+		}
+		item.msg = std::move(msg);
+		item.state.store(make_state(id, slot_busy), std::memory_order_release);
+		return id;
+	}
+	return 0;
+}
+
+std::shared_ptr<response_message> pending_table::take(uint32_t id)
+{
+	slot& item = m_slots[id & m_index_mask];
+	uint64_t expected = make_state(id, slot_busy);
+	if(!item.state.compare_exchange_strong(expected, make_state(id, slot_taking), std::memory_order_acq_rel)) {
+		return nullptr; // Not pending (stale id, already taken or still claiming)
+	}
+	std::shared_ptr<response_message> msg = std::move(item.msg);
+	item.state.store(make_state(next_id(id), slot_free), std::memory_order_release);
+	return msg;
+}
+
+} // end of namespace ipc
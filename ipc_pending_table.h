@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "ipc_data.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Fixed capacity table of messages waiting for response.
+// Message id is (generation << index bits | slot index), so response find its slot in O(1),
+// old (stale) id never match reused slot. Top bit is never set (ids of response streams have it). Claim/take are lock-free (CAS on slot state),
+// no allocation per message.
+class pending_table
+{
+public:
+	static constexpr uint32_t default_capacity = 4096; // Must be power of two
+
+	pending_table(uint32_t capacity = default_capacity);
+
+	pending_table(const pending_table&) = delete;
+	pending_table& operator=(const pending_table&) = delete;
+
+	// Store message to free slot, return its id (0 when table is full)
+	uint32_t claim(std::shared_ptr<response_message> msg);
+	// Remove message from slot (nullptr when id is not pending, e.g. already taken)
+	std::shared_ptr<response_message> take(uint32_t id);
+	// Call fn for every pending message after it was removed from table
+	template<class Fn>
+	void take_all(Fn fn) {
+		for(uint32_t i = 0; i < m_capacity; i++) {
+			uint64_t state = m_slots[i].state.load();
+			if(status(state) == slot_busy) {
+				std::shared_ptr<response_message> msg = take(slot_id(state));
+				if(msg) fn(msg);
+			}
+		}
+	}
+
+private:
+	enum slot_status : uint32_t {
+		slot_free = 0,
+		slot_claiming = 1,
+		slot_busy = 2,
+		slot_taking = 3,
+	};
+
+	// State = id << 32 | status (id of free slot is id for the next claim)
+	static uint64_t make_state(uint32_t id, slot_status status) {
+		return (static_cast<uint64_t>(id) << 32) | status;
+	}
+	static uint32_t slot_id(uint64_t state) {
+		return static_cast<uint32_t>(state >> 32);
+	}
+	static slot_status status(uint64_t state) {
+		return static_cast<slot_status>(state & 0xFFFFFFFF);
+	}
+	uint32_t next_id(uint32_t id) const;
+
+	struct alignas(64) slot {
+		std::atomic<uint64_t> state;
+		std::shared_ptr<response_message> msg;  // Valid in slot_busy, owned by who moved state
+	};
+
+private:
+	uint32_t m_capacity = 0;
+	uint32_t m_index_mask = 0;
+	uint32_t m_index_bits = 0;
+	std::unique_ptr<slot[]> m_slots;
+	std::atomic<uint32_t> m_claim_hint = 0;  // Where next claim start to search
+};
+
+} // end of namespace ipc
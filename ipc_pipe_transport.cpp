@@ -0,0 +1,248 @@
+#include "stdafx.h"
+#include "ipc_pipe_transport.h"
+#include <algorithm>
+#include <iterator>
+#include <string.h>
+
+namespace ipc {
+
+pipe_transport::pipe_transport(client_connection& connection)
+	: pipe_transport(connection.read_pipe, connection.write_pipe)
+{
+	// We own pipes now
+	connection.read_pipe = invalid_handle;
+	connection.write_pipe = invalid_handle;
+}
+
+pipe_transport::pipe_transport(native_handle read_handle, native_handle write_handle)
+	: m_wakeup(true)
+	, m_read_buffer(read_buffer_size)
+{
+	m_connection.read_pipe = read_handle;
+	m_connection.write_pipe = write_handle;
+	// Reader sleep in poll on read handle and wakeup event (instead of blocking read), so wakeup() can stop it
+	platform::set_nonblocking(m_connection.read_pipe);
+}
+
+pipe_transport::~pipe_transport()
+{
+	close_write();
+	close_read();
+}
+
+platform::io_result pipe_transport::write_frame(const header& header_data, message_parts parts)
+{
+	//////////////////////////////////////////////////////////////////////////
+	// Write header + message by one write, so other side never wake up on header only
+	// (long gather list continue by next writes, we are the only writer)
+	constexpr size_t max_buffers = 16;
+	platform::io_buffer buffers[max_buffers];
+	buffers[0].data = &header_data;
+	buffers[0].size = sizeof(ipc::header);
+	size_t count = 1;
+
+	for(const message_view& part : parts) {
+		if(count == max_buffers) {
+			platform::io_result result = platform::write_all(m_connection.write_pipe, buffers, count);
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+			count = 0;
+		}
+		buffers[count].data = part.data();
+		buffers[count].size = part.size();
+		count++;
+	}
+	return platform::write_all(m_connection.write_pipe, buffers, count);
+}
+
+platform::io_result pipe_transport::write_frame_stable(const header& header_data, message_parts parts)
+{
+	if(!m_bulk_threshold || header_data.message_size < m_bulk_threshold) {
+		return write_frame(header_data, parts);
+	}
+
+	// Header is copied (it is on caller stack), payload pages are passed to pipe and other side copy them
+	// directly out of our memory (one copy instead of two)
+	platform::io_result result = platform::write_all(m_connection.write_pipe, &header_data, sizeof(ipc::header));
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	constexpr size_t max_buffers = 16;
+	platform::io_buffer buffers[max_buffers];
+	size_t count = 0;
+	for(const message_view& part : parts) {
+		if(count == max_buffers) {
+			result = platform::splice_all(m_connection.write_pipe, buffers, count);
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+			count = 0;
+		}
+		buffers[count].data = part.data();
+		buffers[count].size = part.size();
+		count++;
+	}
+	return platform::splice_all(m_connection.write_pipe, buffers, count);
+}
+
+void pipe_transport::set_bulk_mode(uint32_t bulk_threshold, uint32_t pipe_size)
+{
+	m_bulk_threshold = bulk_threshold;
+	if(pipe_size) {
+		// Both sides resize, whoever is first, pipe has the size then
+		platform::set_pipe_size(m_connection.write_pipe, pipe_size);
+		platform::set_pipe_size(m_connection.read_pipe, pipe_size);
+	}
+}
+
+platform::io_result pipe_transport::read_frame(header& header_data, std::vector<uint8_t>& payload)
+{
+	platform::io_result result = read_header(header_data);
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	return read_payload(header_data, payload);
+}
+
+platform::io_result pipe_transport::read_frame_view(header& header_data, message_view& payload)
+{
+	platform::io_result result = read_header(header_data);
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+
+	if(header_data.message_size > m_read_buffer.size()) {
+		// Does not fit into read buffer, read it into own buffer
+		result = read_payload(header_data, m_view_buffer);
+		payload = to_view(m_view_buffer);
+		return result;
+	}
+
+	// Whole message into read buffer (fill move partial frame to buffer begin), payload point there
+	while(buffered_size() < header_data.message_size) {
+		result = fill_read_buffer();
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+	payload = message_view(reinterpret_cast<const std::byte*>(m_read_buffer.data() + m_read_begin), header_data.message_size);
+	m_read_begin += header_data.message_size;
+	return platform::io_result::ok;
+}
+
+platform::io_result pipe_transport::read_header(header& header_data)
+{
+	//////////////////////////////////////////////////////////////////////////
+	// Read HEADER
+	while(buffered_size() < sizeof(header)) {
+		platform::io_result result = fill_read_buffer();
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+	::memcpy(&header_data, m_read_buffer.data() + m_read_begin, sizeof(header));
+	m_read_begin += sizeof(header);
+	if(header_data.message_size > m_max_message_size) {
+		return platform::io_result::failed;
+	}
+	return platform::io_result::ok;
+}
+
+platform::io_result pipe_transport::read_payload(const header& header_data, std::vector<uint8_t>& payload)
+{
+	//////////////////////////////////////////////////////////////////////////
+	// Read MESSAGE (what we already have in buffer first)
+	prepare_payload(payload, header_data.message_size);
+	size_t copied = std::min<size_t>(buffered_size(), header_data.message_size);
+	if(copied) {
+		// Append instead of resize + copy, buffered part is not zero-filled first
+		const uint8_t* buffered = m_read_buffer.data() + m_read_begin;
+		payload.insert(payload.end(), buffered, buffered + copied);
+		m_read_begin += copied;
+	}
+	payload.resize(header_data.message_size);
+
+	size_t remaining = header_data.message_size - copied;
+	if(remaining >= read_buffer_size / 2) {
+		// Big message, read rest directly (no copy through buffer)
+		return platform::read_exact(m_connection.read_pipe, payload.data() + copied, remaining, m_wakeup);
+	}
+	while(remaining > 0) {
+		platform::io_result result = fill_read_buffer();
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+		size_t count = std::min(buffered_size(), remaining);
+		::memcpy(payload.data() + copied, m_read_buffer.data() + m_read_begin, count);
+		m_read_begin += count;
+		copied += count;
+		remaining -= count;
+	}
+	return platform::io_result::ok;
+}
+
+frame_state pipe_transport::poll_frame(header& header_data)
+{
+	while(true) {
+		if(buffered_size() >= sizeof(header)) {
+			::memcpy(&header_data, m_read_buffer.data() + m_read_begin, sizeof(header));
+			if(buffered_size() - sizeof(header) >= header_data.message_size) {
+				return frame_state::complete;
+			}
+			if(sizeof(header) + header_data.message_size > m_read_buffer.size()) {
+				return frame_state::unbuffered;
+			}
+		}
+
+		compact_read_buffer();
+		size_t read_size = 0;
+		platform::io_result result = platform::read_available(m_connection.read_pipe, m_read_buffer.data() + m_read_end, m_read_buffer.size() - m_read_end, read_size);
+		if(result != platform::io_result::ok) {
+			return frame_state::unbuffered;  // Read report it
+		}
+		if(read_size == 0) {
+			return frame_state::partial;
+		}
+		m_read_end += read_size;
+	}
+}
+
+void pipe_transport::compact_read_buffer()
+{
+	// Move partial frame to buffer begin
+	if(m_read_begin == m_read_end) {
+		m_read_begin = m_read_end = 0;
+	} else if(m_read_begin > 0) {
+		::memmove(m_read_buffer.data(), m_read_buffer.data() + m_read_begin, buffered_size());
+		m_read_end -= m_read_begin;
+		m_read_begin = 0;
+	}
+}
+
+platform::io_result pipe_transport::fill_read_buffer()
+{
+	compact_read_buffer();
+
+	size_t read_size = 0;
+	platform::io_result result = platform::read_some(m_connection.read_pipe, m_read_buffer.data() + m_read_end, m_read_buffer.size() - m_read_end, read_size, m_wakeup);
+	m_read_end += read_size;
+	return result;
+}
+
+void pipe_transport::close_write()
+{
+	platform::close_handle(m_connection.write_pipe);
+}
+
+void pipe_transport::close_read()
+{
+	platform::close_handle(m_connection.read_pipe);
+}
+
+void pipe_transport::wakeup()
+{
+	platform::wake_reader(m_connection.read_pipe, m_wakeup);
+}
+
+} // end of namespace ipc
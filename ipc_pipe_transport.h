@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ipc_transport.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Anonymous pipes transport
+class pipe_transport : public transport
+{
+public:
+	pipe_transport(client_connection& connection);
+	~pipe_transport();
+
+	//! \copydoc transport::write_frame
+	platform::io_result write_frame(const header& header_data, message_parts parts) override;
+	using transport::write_frame;
+	//! \copydoc transport::write_frame_stable
+	platform::io_result write_frame_stable(const header& header_data, message_parts parts) override;
+	//! \copydoc transport::read_frame
+	platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) override;
+	//! \copydoc transport::read_frame_view
+	platform::io_result read_frame_view(header& header_data, message_view& payload) override;
+	//! \copydoc transport::set_bulk_mode
+	void set_bulk_mode(uint32_t bulk_threshold, uint32_t pipe_size) override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+	//! \copydoc transport::wakeup
+	void wakeup() override;
+	//! \copydoc transport::read_handle
+	native_handle read_handle() const override {
+		return m_connection.read_pipe;
+	}
+	//! \copydoc transport::poll_frame
+	frame_state poll_frame(header& header_data) override;
+
+protected:
+	// Take ownership of handles (they can be one bidirectional handle)
+	pipe_transport(native_handle read_handle, native_handle write_handle);
+
+private:
+	platform::io_result read_header(header& header_data);
+	platform::io_result read_payload(const header& header_data, std::vector<uint8_t>& payload);
+
+	// Read buffer, one read syscall bring as many frames as pipe has
+	platform::io_result fill_read_buffer();
+	void compact_read_buffer();
+	size_t buffered_size() const {
+		return m_read_end - m_read_begin;
+	}
+
+private:
+	static constexpr size_t read_buffer_size = 64 * 1024;
+
+protected:
+	client_connection m_connection;
+	uint32_t m_bulk_threshold = 0;  // Stable payloads of this size and bigger are spliced (0 = never)
+
+private:
+	platform::event m_wakeup;       // Set by wakeup(), read waits on it together with read handle
+
+	std::vector<uint8_t> m_read_buffer;
+	size_t m_read_begin = 0;  // First not consumed byte
+	size_t m_read_end = 0;    // End of valid data
+};
+
+} // end of namespace ipc
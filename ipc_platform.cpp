@@ -0,0 +1,969 @@
+#include "stdafx.h"
+#include "ipc_platform.h"
+#include "convert.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sys/uio.h>
+#include <mutex>
+#endif
+
+namespace ipc {
+namespace platform {
+
+#ifdef _WIN32
+
+#pragma region Event
+event::event(bool manual_reset)
+	: m_manual_reset(manual_reset)
+{
+	m_handle = ::CreateEvent(nullptr, manual_reset ? TRUE : FALSE, FALSE, nullptr);
+	if(!m_handle) {
+		throw std::runtime_error(utils::win32_error_to_ansi(::GetLastError()));
+	}
+}
+
+event::~event()
+{
+	close_handle(m_handle);
+}
+
+void event::set()
+{
+	::SetEvent(m_handle);
+}
+
+void event::reset()
+{
+	::ResetEvent(m_handle);
+}
+
+int wait_for_any(event* const* events, size_t count, uint32_t timeout_ms)
+{
+	HANDLE wait_handles[MAXIMUM_WAIT_OBJECTS] = {0};
+	if(count == 0 || count > MAXIMUM_WAIT_OBJECTS) {
+		return -1;
+	}
+	for(size_t i = 0; i < count; i++) {
+		wait_handles[i] = events[i]->handle();
+	}
+
+	DWORD wait_result = ::WaitForMultipleObjects(static_cast<DWORD>(count), wait_handles, FALSE, timeout_ms);
+	if(wait_result >= WAIT_OBJECT_0 && wait_result < WAIT_OBJECT_0 + count) {
+		return static_cast<int>(wait_result - WAIT_OBJECT_0);
+	}
+	return -1;
+}
+#pragma endregion Event
+
+#pragma region WaitSlot
+wait_slot::wait_slot()
+{
+	m_handle = ::CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	if(!m_handle) {
+		throw std::runtime_error(utils::win32_error_to_ansi(::GetLastError()));
+	}
+}
+
+wait_slot::~wait_slot()
+{
+	close_handle(m_handle);
+}
+
+void wait_slot::set()
+{
+	::SetEvent(m_handle);
+}
+
+void wait_slot::reset()
+{
+	::ResetEvent(m_handle);
+}
+
+bool wait_slot::wait(uint32_t timeout_ms)
+{
+	return ::WaitForSingleObject(m_handle, timeout_ms) == WAIT_OBJECT_0;
+}
+#pragma endregion WaitSlot
+
+#pragma region Pipe
+bool create_pipe(native_handle& read_end, native_handle& write_end, bool inherit_read_end, bool inherit_write_end)
+{
+	// Set the bInheritHandle flag so pipe handles are inherited.
+	SECURITY_ATTRIBUTES saAttr;
+	saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
+	saAttr.bInheritHandle = TRUE;
+	saAttr.lpSecurityDescriptor = NULL;
+
+	if(!::CreatePipe(&read_end, &write_end, &saAttr, 0)) {
+		return false;
+	}
+	// Ensure the handles we keep are not inherited.
+	if(!inherit_read_end && !::SetHandleInformation(read_end, HANDLE_FLAG_INHERIT, 0)) {
+		return false;
+	}
+	if(!inherit_write_end && !::SetHandleInformation(write_end, HANDLE_FLAG_INHERIT, 0)) {
+		return false;
+	}
+	return true;
+}
+
+void close_handle(native_handle& handle)
+{
+	if(handle) {
+		::CloseHandle(handle);
+		handle = nullptr;
+	}
+}
+
+static bool is_disconnect_error(DWORD last_error)
+{
+	// ERROR_BROKEN_PIPE write handle closed died
+	// ERROR_PIPE_NOT_CONNECTED master died
+	// ERROR_INVALID_HANDLE close read handle
+	// ERROR_OPERATION_ABORTED read cancelled by wake_reader
+	return last_error == ERROR_BROKEN_PIPE || last_error == ERROR_PIPE_NOT_CONNECTED || last_error == ERROR_INVALID_HANDLE || last_error == ERROR_NO_DATA
+		|| last_error == ERROR_OPERATION_ABORTED;
+}
+
+io_result write_all(native_handle handle, const void* data, size_t size)
+{
+	const uint8_t* ptr = static_cast<const uint8_t*>(data);
+	while(size > 0) {
+		DWORD written_bytes = 0;
+		if(!::WriteFile(handle, ptr, static_cast<DWORD>(size), &written_bytes, nullptr)) {
+			return is_disconnect_error(::GetLastError()) ? io_result::disconnected : io_result::failed;
+		}
+		ptr += written_bytes;
+		size -= written_bytes;
+	}
+	return io_result::ok;
+}
+
+io_result write_all(native_handle handle, const io_buffer* buffers, size_t count)
+{
+	// Small frames are copied into one buffer so the other side get them by one ReadFile,
+	// for big ones the copy cost more than second WriteFile
+	constexpr size_t max_staged_size = 64 * 1024;
+
+	size_t total_size = 0;
+	for(size_t i = 0; i < count; i++) {
+		total_size += buffers[i].size;
+	}
+
+	if(total_size <= max_staged_size) {
+		thread_local std::vector<uint8_t> staging;
+		staging.resize(total_size);
+		size_t offset = 0;
+		for(size_t i = 0; i < count; i++) {
+			if(buffers[i].size) {
+				::memcpy(staging.data() + offset, buffers[i].data, buffers[i].size);
+				offset += buffers[i].size;
+			}
+		}
+		return write_all(handle, staging.data(), staging.size());
+	}
+
+	for(size_t i = 0; i < count; i++) {
+		io_result result = write_all(handle, buffers[i].data, buffers[i].size);
+		if(result != io_result::ok) {
+			return result;
+		}
+	}
+	return io_result::ok;
+}
+
+io_result splice_all(native_handle handle, const io_buffer* buffers, size_t count)
+{
+	// No page passing, pipe copy
+	return write_all(handle, buffers, count);
+}
+
+size_t set_pipe_size(native_handle, size_t)
+{
+	// Buffer size is given by CreatePipe
+	return 0;
+}
+
+io_result read_exact(native_handle handle, void* data, size_t size)
+{
+	uint8_t* ptr = static_cast<uint8_t*>(data);
+	while(size > 0) {
+		DWORD read_bytes = 0;
+		if(!::ReadFile(handle, ptr, static_cast<DWORD>(size), &read_bytes, nullptr)) {
+			return is_disconnect_error(::GetLastError()) ? io_result::disconnected : io_result::failed;
+		}
+		if(read_bytes == 0) {
+			return io_result::disconnected;
+		}
+		ptr += read_bytes;
+		size -= read_bytes;
+	}
+	return io_result::ok;
+}
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size)
+{
+	DWORD read_bytes = 0;
+	read_size = 0;
+	if(!::ReadFile(handle, data, static_cast<DWORD>(size), &read_bytes, nullptr)) {
+		return is_disconnect_error(::GetLastError()) ? io_result::disconnected : io_result::failed;
+	}
+	if(read_bytes == 0) {
+		return io_result::disconnected;
+	}
+	read_size = read_bytes;
+	return io_result::ok;
+}
+
+static bool is_set(const event& wakeup)
+{
+	return ::WaitForSingleObject(wakeup.handle(), 0) == WAIT_OBJECT_0;
+}
+
+io_result read_exact(native_handle handle, void* data, size_t size, const event& wakeup)
+{
+	// Blocked ReadFile is cancelled by wake_reader, event catch wakeup which came before it
+	return is_set(wakeup) ? io_result::disconnected : read_exact(handle, data, size);
+}
+
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size, const event& wakeup)
+{
+	read_size = 0;
+	return is_set(wakeup) ? io_result::disconnected : read_some(handle, data, size, read_size);
+}
+
+io_result read_available(native_handle handle, void* data, size_t size, size_t& read_size)
+{
+	read_size = 0;
+	DWORD available = 0;
+	if(!::PeekNamedPipe(handle, nullptr, 0, nullptr, &available, nullptr)) {
+		return is_disconnect_error(::GetLastError()) ? io_result::disconnected : io_result::failed;
+	}
+	if(available == 0) {
+		return io_result::ok;
+	}
+	return read_some(handle, data, std::min<size_t>(size, available), read_size);
+}
+
+bool set_nonblocking(native_handle)
+{
+	// Reader is woken up by CancelIoEx
+	return true;
+}
+
+void wake_reader(native_handle handle, event& wakeup)
+{
+	wakeup.set();
+	::CancelIoEx(handle, nullptr);
+}
+#pragma endregion Pipe
+
+#pragma region Socket
+bool create_socket_pair(native_handle&, native_handle&, bool, bool, bool)
+{
+	// Anonymous pipes are used instead
+	::SetLastError(ERROR_NOT_SUPPORTED);
+	return false;
+}
+
+void shutdown_write(native_handle)
+{
+}
+
+size_t set_socket_buffer_size(native_handle, size_t)
+{
+	return 0;
+}
+#pragma endregion Socket
+
+#pragma region Blob
+uint32_t current_process_id()
+{
+	return ::GetCurrentProcessId();
+}
+
+uint32_t handle_value(native_handle handle)
+{
+	return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(handle));
+}
+
+bool create_blob(size_t size, native_handle& blob, void*& view)
+{
+	ULARGE_INTEGER section_size;
+	section_size.QuadPart = size ? size : 1;
+	blob = ::CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, section_size.HighPart, section_size.LowPart, nullptr);
+	if(!blob) {
+		blob = invalid_handle;
+		return false;
+	}
+
+	view = ::MapViewOfFile(blob, FILE_MAP_WRITE, 0, 0, section_size.QuadPart);
+	if(!view) {
+		close_handle(blob);
+		return false;
+	}
+	return true;
+}
+
+bool seal_blob(native_handle& blob, void* view, size_t)
+{
+	// Other side get read-only handle, no seal needed
+	::UnmapViewOfFile(view);
+	return true;
+}
+
+mapped_blob::~mapped_blob()
+{
+	close();
+}
+
+bool mapped_blob::open(uint32_t process_id, uint32_t handle, size_t size)
+{
+	close();
+
+	HANDLE process = ::OpenProcess(PROCESS_DUP_HANDLE, FALSE, process_id);
+	if(!process) {
+		return false;
+	}
+	// Read-only duplicate, sender can not be changed by us
+	HANDLE section = nullptr;
+	BOOL duplicated = ::DuplicateHandle(process, reinterpret_cast<HANDLE>(static_cast<uintptr_t>(handle)), ::GetCurrentProcess(), &section, FILE_MAP_READ, FALSE, 0);
+	::CloseHandle(process);
+	if(!duplicated) {
+		return false;
+	}
+
+	m_data = size ? ::MapViewOfFile(section, FILE_MAP_READ, 0, 0, size) : nullptr;
+	::CloseHandle(section);
+	if(size && !m_data) {
+		return false;
+	}
+	m_size = size;
+	return true;
+}
+
+void mapped_blob::close()
+{
+	if(m_data) {
+		::UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	m_size = 0;
+}
+#pragma endregion Blob
+
+int last_error()
+{
+	return static_cast<int>(::GetLastError());
+}
+
+std::string error_to_ansi(int error_code)
+{
+	return utils::win32_error_to_ansi(static_cast<DWORD>(error_code));
+}
+
+#else // POSIX
+
+#pragma region Event
+event::event(bool manual_reset)
+	: m_manual_reset(manual_reset)
+{
+	m_handle = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(m_handle == invalid_handle) {
+		throw std::runtime_error(error_to_ansi(errno));
+	}
+}
+
+event::~event()
+{
+	close_handle(m_handle);
+}
+
+void event::set()
+{
+	uint64_t value = 1;
+	while(::write(m_handle, &value, sizeof(value)) < 0 && errno == EINTR) {}
+}
+
+void event::reset()
+{
+	uint64_t value = 0;
+	while(::read(m_handle, &value, sizeof(value)) < 0 && errno == EINTR) {}
+}
+
+int wait_for_any(event* const* events, size_t count, uint32_t timeout_ms)
+{
+	std::vector<pollfd> fds(count);
+	for(size_t i = 0; i < count; i++) {
+		fds[i].fd = events[i]->handle();
+		fds[i].events = POLLIN;
+	}
+
+	int timeout = (timeout_ms == wait_infinite) ? -1 : static_cast<int>(timeout_ms);
+	while(true) {
+		int result = ::poll(fds.data(), fds.size(), timeout);
+		if(result < 0) {
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		if(result == 0) {
+			return -1; // timeout
+		}
+		for(size_t i = 0; i < count; i++) {
+			if(!(fds[i].revents & POLLIN)) continue;
+			if(events[i]->manual_reset()) {
+				return static_cast<int>(i);
+			}
+			// Auto-reset event, consume the signal (somebody else may be faster, then wait again)
+			uint64_t value = 0;
+			if(::read(fds[i].fd, &value, sizeof(value)) == sizeof(value)) {
+				return static_cast<int>(i);
+			}
+		}
+	}
+}
+#pragma endregion Event
+
+#pragma region WaitSlot
+wait_slot::wait_slot()
+{
+}
+
+wait_slot::~wait_slot()
+{
+}
+
+void wait_slot::set()
+{
+	// Kernel is called only when somebody sleeps on the word
+	if(m_state.exchange(1) == 2) {
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+}
+
+void wait_slot::reset()
+{
+	m_state.store(0);
+}
+
+bool wait_slot::wait(uint32_t timeout_ms)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while(true) {
+		uint32_t state = m_state.load();
+		if(state == 1) {
+			return true;
+		}
+		if(state == 0 && !m_state.compare_exchange_weak(state, 2)) {
+			continue;
+		}
+
+		timespec timeout = {};
+		timespec* timeout_ptr = nullptr;
+		if(timeout_ms != wait_infinite) {
+			auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if(remaining <= 0) {
+				return m_state.load() == 1;
+			}
+			timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+			timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+			timeout_ptr = &timeout;
+		}
+		::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAIT_PRIVATE, 2, timeout_ptr, nullptr, 0);
+	}
+}
+#pragma endregion WaitSlot
+
+#pragma region Pipe
+static void ignore_sigpipe()
+{
+	// Write to pipe without reader raise SIGPIPE (default action terminate process), we want EPIPE instead
+	static std::once_flag once;
+	std::call_once(once, []() {
+		::signal(SIGPIPE, SIG_IGN);
+	});
+}
+
+bool create_pipe(native_handle& read_end, native_handle& write_end, bool inherit_read_end, bool inherit_write_end)
+{
+	ignore_sigpipe();
+
+	int fds[2] = {invalid_handle, invalid_handle};
+	if(::pipe2(fds, O_CLOEXEC) != 0) {
+		return false;
+	}
+	read_end = fds[0];
+	write_end = fds[1];
+
+	// Handles passed to the child must survive exec
+	if(inherit_read_end && ::fcntl(read_end, F_SETFD, 0) != 0) {
+		return false;
+	}
+	if(inherit_write_end && ::fcntl(write_end, F_SETFD, 0) != 0) {
+		return false;
+	}
+	return true;
+}
+
+void close_handle(native_handle& handle)
+{
+	if(handle != invalid_handle) {
+		::close(handle);
+		handle = invalid_handle;
+	}
+}
+
+// Non-blocking handle (socket shared with reader) is full, wait for room
+static bool wait_writable(native_handle handle)
+{
+	pollfd fd = {handle, POLLOUT, 0};
+	while(::poll(&fd, 1, -1) < 0) {
+		if(errno != EINTR) {
+			return false;
+		}
+	}
+	return true;
+}
+
+io_result write_all(native_handle handle, const void* data, size_t size)
+{
+	const uint8_t* ptr = static_cast<const uint8_t*>(data);
+	while(size > 0) {
+		ssize_t written_bytes = ::write(handle, ptr, size);
+		if(written_bytes < 0) {
+			if(errno == EINTR) continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(handle)) continue;
+			return (errno == EPIPE || errno == EBADF) ? io_result::disconnected : io_result::failed;
+		}
+		ptr += written_bytes;
+		size -= static_cast<size_t>(written_bytes);
+	}
+	return io_result::ok;
+}
+
+// Gathered write of buffers (writev, or vmsplice which pass pages by reference)
+static io_result write_buffers(native_handle handle, const io_buffer* buffers, size_t count, bool by_reference)
+{
+	constexpr size_t max_buffers = 16;
+	if(count > max_buffers) {
+		// Long gather list, write it by parts (caller serialize writes, so frame stay in one piece)
+		for(size_t offset = 0; offset < count; offset += max_buffers) {
+			io_result result = write_buffers(handle, buffers + offset, std::min(max_buffers, count - offset), by_reference);
+			if(result != io_result::ok) {
+				return result;
+			}
+		}
+		return io_result::ok;
+	}
+
+	iovec vectors[max_buffers];
+	size_t vector_count = 0;
+	for(size_t i = 0; i < count; i++) {
+		if(buffers[i].size) {
+			vectors[vector_count].iov_base = const_cast<void*>(buffers[i].data);
+			vectors[vector_count].iov_len = buffers[i].size;
+			vector_count++;
+		}
+	}
+
+	iovec* current = vectors;
+	while(vector_count > 0) {
+		ssize_t written_bytes = by_reference
+			? ::vmsplice(handle, current, vector_count, 0)
+			: ::writev(handle, current, static_cast<int>(vector_count));
+		if(written_bytes < 0) {
+			if(errno == EINTR) continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && wait_writable(handle)) continue;
+			return (errno == EPIPE || errno == EBADF) ? io_result::disconnected : io_result::failed;
+		}
+		// Short write, skip what was written and continue with the rest
+		size_t written = static_cast<size_t>(written_bytes);
+		while(vector_count > 0 && written >= current->iov_len) {
+			written -= current->iov_len;
+			current++;
+			vector_count--;
+		}
+		if(vector_count > 0) {
+			current->iov_base = static_cast<uint8_t*>(current->iov_base) + written;
+			current->iov_len -= written;
+		}
+	}
+	return io_result::ok;
+}
+
+io_result write_all(native_handle handle, const io_buffer* buffers, size_t count)
+{
+	return write_buffers(handle, buffers, count, false);
+}
+
+io_result splice_all(native_handle handle, const io_buffer* buffers, size_t count)
+{
+	return write_buffers(handle, buffers, count, true);
+}
+
+size_t set_pipe_size(native_handle handle, size_t size)
+{
+	// Unprivileged process is limited by /proc/sys/fs/pipe-max-size, keep what we have then
+	if(size <= INT_MAX) {
+		::fcntl(handle, F_SETPIPE_SZ, static_cast<int>(size));
+	}
+	int pipe_size = ::fcntl(handle, F_GETPIPE_SZ);
+	return pipe_size > 0 ? static_cast<size_t>(pipe_size) : 0;
+}
+
+io_result read_exact(native_handle handle, void* data, size_t size)
+{
+	uint8_t* ptr = static_cast<uint8_t*>(data);
+	while(size > 0) {
+		ssize_t read_bytes = ::read(handle, ptr, size);
+		if(read_bytes < 0) {
+			if(errno == EINTR) continue;
+			return (errno == EBADF) ? io_result::disconnected : io_result::failed;
+		}
+		if(read_bytes == 0) {
+			return io_result::disconnected; // EOF, all write ends closed
+		}
+		ptr += read_bytes;
+		size -= static_cast<size_t>(read_bytes);
+	}
+	return io_result::ok;
+}
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size)
+{
+	read_size = 0;
+	while(true) {
+		ssize_t read_bytes = ::read(handle, data, size);
+		if(read_bytes < 0) {
+			if(errno == EINTR) continue;
+			return (errno == EBADF) ? io_result::disconnected : io_result::failed;
+		}
+		if(read_bytes == 0) {
+			return io_result::disconnected; // EOF, all write ends closed
+		}
+		read_size = static_cast<size_t>(read_bytes);
+		return io_result::ok;
+	}
+}
+
+io_result read_exact(native_handle handle, void* data, size_t size, const event& wakeup)
+{
+	uint8_t* ptr = static_cast<uint8_t*>(data);
+	while(size > 0) {
+		size_t read_size = 0;
+		io_result result = read_some(handle, ptr, size, read_size, wakeup);
+		if(result != io_result::ok) {
+			return result;
+		}
+		ptr += read_size;
+		size -= read_size;
+	}
+	return io_result::ok;
+}
+
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size, const event& wakeup)
+{
+	read_size = 0;
+	while(true) {
+		// Data first, busy connection never poll
+		ssize_t read_bytes = ::read(handle, data, size);
+		if(read_bytes > 0) {
+			read_size = static_cast<size_t>(read_bytes);
+			return io_result::ok;
+		}
+		if(read_bytes == 0) {
+			return io_result::disconnected; // EOF, all write ends closed
+		}
+		if(errno == EINTR) continue;
+		if(errno != EAGAIN && errno != EWOULDBLOCK) {
+			return (errno == EBADF) ? io_result::disconnected : io_result::failed;
+		}
+
+		// Nothing there, sleep until data (or hang-up) or wakeup
+		pollfd fds[2] = {{handle, POLLIN, 0}, {wakeup.handle(), POLLIN, 0}};
+		if(::poll(fds, 2, -1) < 0 && errno != EINTR) {
+			return io_result::failed;
+		}
+		if(fds[1].revents & POLLIN) {
+			return io_result::disconnected;
+		}
+	}
+}
+
+io_result read_available(native_handle handle, void* data, size_t size, size_t& read_size)
+{
+	read_size = 0;
+	while(true) {
+		ssize_t read_bytes = ::read(handle, data, size);
+		if(read_bytes > 0) {
+			read_size = static_cast<size_t>(read_bytes);
+			return io_result::ok;
+		}
+		if(read_bytes == 0) {
+			return io_result::disconnected; // EOF, all write ends closed
+		}
+		if(errno == EINTR) continue;
+		if(errno == EAGAIN || errno == EWOULDBLOCK) {
+			return io_result::ok;
+		}
+		return (errno == EBADF) ? io_result::disconnected : io_result::failed;
+	}
+}
+
+bool set_nonblocking(native_handle handle)
+{
+	int flags = ::fcntl(handle, F_GETFL);
+	return flags >= 0 && ::fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void wake_reader(native_handle, event& wakeup)
+{
+	wakeup.set();
+}
+#pragma endregion Pipe
+
+#pragma region Socket
+bool create_socket_pair(native_handle& first, native_handle& second, bool inherit_first, bool inherit_second, bool packet)
+{
+	ignore_sigpipe();
+
+	int fds[2] = {invalid_handle, invalid_handle};
+	if(::socketpair(AF_UNIX, (packet ? SOCK_SEQPACKET : SOCK_STREAM) | SOCK_CLOEXEC, 0, fds) != 0) {
+		return false;
+	}
+	first = fds[0];
+	second = fds[1];
+
+	// Handles passed to the child must survive exec
+	if(inherit_first && ::fcntl(first, F_SETFD, 0) != 0) {
+		return false;
+	}
+	if(inherit_second && ::fcntl(second, F_SETFD, 0) != 0) {
+		return false;
+	}
+	return true;
+}
+
+void shutdown_write(native_handle handle)
+{
+	if(handle != invalid_handle) {
+		::shutdown(handle, SHUT_WR);
+	}
+}
+
+size_t set_socket_buffer_size(native_handle handle, size_t size)
+{
+	// Kernel double the value (bookkeeping overhead) and limit it by net.core.wmem_max/rmem_max
+	if(size <= INT_MAX / 2) {
+		int value = static_cast<int>(size);
+		::setsockopt(handle, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+		::setsockopt(handle, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+	}
+	int send_size = 0;
+	socklen_t length = sizeof(send_size);
+	if(::getsockopt(handle, SOL_SOCKET, SO_SNDBUF, &send_size, &length) != 0) {
+		return 0;
+	}
+	return send_size > 0 ? static_cast<size_t>(send_size) : 0;
+}
+#pragma endregion Socket
+
+#pragma region Blob
+uint32_t current_process_id()
+{
+	return static_cast<uint32_t>(::getpid());
+}
+
+uint32_t handle_value(native_handle handle)
+{
+	return static_cast<uint32_t>(handle);
+}
+
+bool create_blob(size_t size, native_handle& blob, void*& view)
+{
+	blob = ::memfd_create("ipc_comm_blob", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if(blob == invalid_handle) {
+		return false;
+	}
+	if(::ftruncate(blob, static_cast<off_t>(size)) != 0) {
+		close_handle(blob);
+		return false;
+	}
+
+	view = ::mmap(nullptr, std::max<size_t>(size, 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, blob, 0);
+	if(view == MAP_FAILED) {
+		view = nullptr;
+		close_handle(blob);
+		return false;
+	}
+	return true;
+}
+
+bool seal_blob(native_handle& blob, void* view, size_t size)
+{
+	::munmap(view, std::max<size_t>(size, 1));
+
+	// Content is final, other side can rely on it (write seal need no writable mapping)
+	if(::fcntl(blob, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+		close_handle(blob);
+		return false;
+	}
+	return true;
+}
+
+mapped_blob::~mapped_blob()
+{
+	close();
+}
+
+bool mapped_blob::open(uint32_t process_id, uint32_t handle, size_t size)
+{
+	close();
+
+	char path[64];
+	::snprintf(path, sizeof(path), "/proc/%u/fd/%u", process_id, handle);
+	int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		return false;
+	}
+
+	// Blob must be sealed and as big as announced (sender can not shrink it under our mapping)
+	struct stat info;
+	int seals = ::fcntl(fd, F_GET_SEALS);
+	bool valid = ::fstat(fd, &info) == 0 && static_cast<uint64_t>(info.st_size) == size
+		&& seals >= 0 && (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) == (F_SEAL_SHRINK | F_SEAL_WRITE);
+	if(valid && size) {
+		m_data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+		valid = m_data != MAP_FAILED;
+		if(!valid) {
+			m_data = nullptr;
+		}
+	}
+	::close(fd);
+	if(!valid) {
+		return false;
+	}
+	m_size = size;
+	return true;
+}
+
+void mapped_blob::close()
+{
+	if(m_data) {
+		::munmap(m_data, m_size);
+		m_data = nullptr;
+	}
+	m_size = 0;
+}
+#pragma endregion Blob
+
+int last_error()
+{
+	return errno;
+}
+
+std::string error_to_ansi(int error_code)
+{
+	return ::strerror(error_code);
+}
+
+#endif
+
+#pragma region WaitPool
+wait_pool& wait_pool::global()
+{
+	static wait_pool pool;
+	return pool;
+}
+
+wait_pool::wait_pool(size_t max_cached)
+	: m_max_cached(max_cached)
+{
+}
+
+wait_pool::~wait_pool()
+{
+	for(wait_slot* slot : m_free_slots) {
+		delete slot;
+	}
+}
+
+void wait_pool::reserve(size_t count)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	while(m_free_slots.size() < count) {
+		m_free_slots.push_back(new wait_slot());
+	}
+	if(m_max_cached < count) {
+		m_max_cached = count;
+	}
+}
+
+void wait_pool::set_max_cached(size_t max_cached)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_max_cached = max_cached;
+	while(m_free_slots.size() > m_max_cached) {
+		delete m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+}
+
+wait_slot* wait_pool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if(!m_free_slots.empty()) {
+			wait_slot* slot = m_free_slots.back();
+			m_free_slots.pop_back();
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			return slot;
+		}
+	}
+	m_misses.fetch_add(1, std::memory_order_relaxed);
+	return new wait_slot();
+}
+
+void wait_pool::release(wait_slot* slot)
+{
+	if(!slot) return;
+	slot->reset();
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if(m_free_slots.size() < m_max_cached) {
+			m_free_slots.push_back(slot);
+			return;
+		}
+	}
+	delete slot;
+}
+
+wait_pool::statistics wait_pool::stats()
+{
+	statistics result;
+	result.hits = m_hits.load();
+	result.misses = m_misses.load();
+	std::lock_guard<std::mutex> guard(m_lock);
+	result.cached = m_free_slots.size();
+	return result;
+}
+#pragma endregion WaitPool
+
+} // end of namespace platform
+} // end of namespace ipc
@@ -0,0 +1,223 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Native OS handle (pipe end, event, ...)
+#ifdef _WIN32
+using native_handle = HANDLE;
+constexpr native_handle invalid_handle = nullptr;
+#else
+using native_handle = int;
+constexpr native_handle invalid_handle = -1;
+#endif
+
+namespace platform {
+
+constexpr uint32_t wait_infinite = 0xFFFFFFFF;
+
+//////////////////////////////////////////////////////////////////////////
+// Result of pipe I/O
+enum class io_result {
+	ok,
+	disconnected, // Other side closed the pipe (or our handle was closed)
+	failed,       // Any other error, see last_error()
+};
+
+//////////////////////////////////////////////////////////////////////////
+// One part of gathered write
+struct io_buffer {
+	const void* data = nullptr;
+	size_t size = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Event object (CreateEvent on Windows, eventfd on POSIX)
+class event
+{
+public:
+	event(bool manual_reset);
+	~event();
+
+	event(const event&) = delete;
+	event& operator=(const event&) = delete;
+
+	void set();
+	void reset();
+
+	native_handle handle() const {
+		return m_handle;
+	}
+	bool manual_reset() const {
+		return m_manual_reset;
+	}
+
+private:
+	native_handle m_handle = invalid_handle;
+	bool m_manual_reset = false;
+};
+
+// Wait until one of events is signaled, return its index, -1 on timeout or error.
+// Auto-reset events are reset by the successful wait (same as WaitForMultipleObjects).
+int wait_for_any(event* const* events, size_t count, uint32_t timeout_ms = wait_infinite);
+
+//////////////////////////////////////////////////////////////////////////
+// One waiter signal (manual-reset event on Windows, futex word on Linux),
+// set() without waiting thread is user-space operation on Linux
+class wait_slot
+{
+public:
+	wait_slot();
+	~wait_slot();
+
+	wait_slot(const wait_slot&) = delete;
+	wait_slot& operator=(const wait_slot&) = delete;
+
+	void set();
+	// Only when nobody waits (slot is being recycled)
+	void reset();
+	// Return false on timeout
+	bool wait(uint32_t timeout_ms = wait_infinite);
+
+private:
+#ifdef _WIN32
+	native_handle m_handle = invalid_handle;
+#else
+	std::atomic<uint32_t> m_state = 0; // 0 = not set, 1 = set, 2 = not set and somebody waits
+#endif
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Pool of wait slots recycled across requests (so request does not create/close kernel object)
+class wait_pool
+{
+public:
+	struct statistics {
+		uint64_t hits = 0;   // Slot taken from pool
+		uint64_t misses = 0; // Pool empty, new slot created
+		size_t cached = 0;   // Free slots in pool now
+	};
+
+	// Process wide pool (slot can outlive connection which used it)
+	static wait_pool& global();
+
+	wait_pool(size_t max_cached = 1024);
+	~wait_pool();
+
+	wait_pool(const wait_pool&) = delete;
+	wait_pool& operator=(const wait_pool&) = delete;
+
+	// Pre-create slots, so first requests do not miss
+	void reserve(size_t count);
+	// Slots over this limit are destroyed on release
+	void set_max_cached(size_t max_cached);
+
+	// Returned slot is not set
+	wait_slot* acquire();
+	void release(wait_slot* slot);
+
+	statistics stats();
+
+private:
+	std::mutex m_lock;
+	std::vector<wait_slot*> m_free_slots;
+	size_t m_max_cached = 0;
+	std::atomic<uint64_t> m_hits = 0;
+	std::atomic<uint64_t> m_misses = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Pipes
+bool create_pipe(native_handle& read_end, native_handle& write_end, bool inherit_read_end, bool inherit_write_end);
+void close_handle(native_handle& handle);
+
+// Write whole buffer (loops over partial writes)
+io_result write_all(native_handle handle, const void* data, size_t size);
+// Write all buffers as one gathered write (writev on POSIX, one staged WriteFile on Windows),
+// loops over partial writes (and over groups of buffers for long lists)
+io_result write_all(native_handle handle, const io_buffer* buffers, size_t count);
+// Write all buffers by passing their pages to pipe (vmsplice on Linux, write_all elsewhere), memory must not be
+// changed until other side read it
+io_result splice_all(native_handle handle, const io_buffer* buffers, size_t count);
+// Resize pipe buffer (F_SETPIPE_SZ), return resulting size (0 when not supported)
+size_t set_pipe_size(native_handle handle, size_t size);
+// Read exactly size bytes (loops over partial reads)
+io_result read_exact(native_handle handle, void* data, size_t size);
+// Read what is available (at least 1 byte, at most size bytes, block when nothing available)
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size);
+// Same reads, but waiting for data is aborted (io_result::disconnected) when wakeup event is set
+// (on POSIX handle must be non-blocking, reader sleep in poll on both handle and event)
+io_result read_exact(native_handle handle, void* data, size_t size, const event& wakeup);
+io_result read_some(native_handle handle, void* data, size_t size, size_t& read_size, const event& wakeup);
+// Read what is available without waiting, read_size is 0 when nothing arrived (on POSIX handle must be non-blocking)
+io_result read_available(native_handle handle, void* data, size_t size, size_t& read_size);
+// Make reads of handle non-blocking (POSIX, writes wait for room by poll), nothing on Windows
+bool set_nonblocking(native_handle handle);
+// Abort read waiting on handle (set wakeup event, cancel blocked ReadFile on Windows)
+void wake_reader(native_handle handle, event& wakeup);
+
+//////////////////////////////////////////////////////////////////////////
+// Sockets (connected pair of unix domain sockets, POSIX only), stream ones are read and written by pipe functions,
+// packet ones (SOCK_SEQPACKET) keep message boundaries
+bool create_socket_pair(native_handle& first, native_handle& second, bool inherit_first, bool inherit_second, bool packet = false);
+// Stop sending (other side read end with io_result::disconnected), we can still read
+void shutdown_write(native_handle handle);
+// Socket send and receive buffer size (SO_SNDBUF/SO_RCVBUF), return resulting send buffer size (0 when not supported)
+size_t set_socket_buffer_size(native_handle handle, size_t size);
+
+//////////////////////////////////////////////////////////////////////////
+// Shared memory blob (big message is placed into it, other process map it instead of read it).
+// Sealed memfd on Linux (other side open it by /proc/<pid>/fd/<fd>), section object on Windows
+// (other side duplicate handle from our process).
+uint32_t current_process_id();
+// Handle as number other process can refer to (kernel handles have 32 significant bits also on 64-bit Windows)
+uint32_t handle_value(native_handle handle);
+// Create blob and map it writable, caller fill it and call seal_blob (blob handle is kept by creator until other side opened it)
+bool create_blob(size_t size, native_handle& blob, void*& view);
+// Unmap view and make blob content final (close blob on failure)
+bool seal_blob(native_handle& blob, void* view, size_t size);
+
+// Read-only mapping of blob created by other process
+class mapped_blob
+{
+public:
+	mapped_blob() = default;
+	~mapped_blob();
+
+	mapped_blob(const mapped_blob&) = delete;
+	mapped_blob& operator=(const mapped_blob&) = delete;
+
+	// Open blob (handle is valid in process_id) and map size bytes of it
+	bool open(uint32_t process_id, uint32_t handle, size_t size);
+	void close();
+
+	const uint8_t* data() const {
+		return static_cast<const uint8_t*>(m_data);
+	}
+	size_t size() const {
+		return m_size;
+	}
+
+private:
+	void* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Errors
+int last_error();
+std::string error_to_ansi(int error_code);
+
+} // end of namespace platform
+} // end of namespace ipc
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "ipc_reactor.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stdexcept>
+#include "ipc_platform.h"
+
+namespace ipc {
+
+constexpr uint64_t stop_id = 0;  // Registration ids start from 1
+
+reactor::reactor(uint32_t threads)
+	: m_workers(threads ? threads : 1)
+{
+	m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+	m_stop_event = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(m_epoll < 0 || m_stop_event < 0) {
+		std::string error = platform::error_to_ansi(platform::last_error());
+		stop();
+		throw std::runtime_error("Create reactor fail: " + error);
+	}
+	// Level triggered, every thread wake up on it
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = stop_id;
+	::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_stop_event, &event);
+
+	if(threads == 0) {
+		threads = 1;
+	}
+	for(uint32_t i = 0; i < threads; i++) {
+		m_threads.emplace_back(&reactor::loop, this);
+	}
+}
+
+reactor::~reactor()
+{
+	stop();
+}
+
+uint64_t reactor::add(native_handle handle, handler_fn fn)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	uint64_t id = m_next_id++;
+	std::shared_ptr<registration> entry = std::make_shared<registration>();
+	entry->handle = handle;
+	entry->fn = std::move(fn);
+	// Registered first, event can come right after epoll_ctl (loop thread wait for our lock)
+	m_registrations.emplace(id, entry);
+
+	epoll_event event = {};
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.u64 = id;
+	if(::epoll_ctl(m_epoll, EPOLL_CTL_ADD, handle, &event) != 0) {
+		m_registrations.erase(id);
+		return 0;
+	}
+	return id;
+}
+
+void reactor::remove(uint64_t id)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	auto it = m_registrations.find(id);
+	if(it == m_registrations.end()) {
+		return;
+	}
+	std::shared_ptr<registration> entry = it->second;
+	entry->removed = true;
+	if(!entry->busy) {
+		// Event already taken by loop thread find no registration
+		::epoll_ctl(m_epoll, EPOLL_CTL_DEL, entry->handle, nullptr);
+		m_registrations.erase(it);
+		return;
+	}
+	if(entry->running == std::this_thread::get_id()) {
+		return; // Called from handler, it is dropped when handler return
+	}
+	m_handler_done.wait(guard, [&]() {
+		return m_registrations.find(id) == m_registrations.end();
+	});
+}
+
+void reactor::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stopping = true;
+	}
+	if(m_stop_event >= 0) {
+		uint64_t value = 1;
+		ssize_t written = ::write(m_stop_event, &value, sizeof(value));
+		(void)written;
+	}
+	for(std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+	m_workers.stop();
+	{
+		// Nobody run handlers now (worker calls not started were dropped), remove() has nothing to wait for
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_registrations.clear();
+		m_handler_done.notify_all();
+	}
+
+	if(m_epoll >= 0) {
+		::close(m_epoll);
+		m_epoll = -1;
+	}
+	if(m_stop_event >= 0) {
+		::close(m_stop_event);
+		m_stop_event = -1;
+	}
+}
+
+void reactor::loop()
+{
+	while(true) {
+		// One ready connection per wake up, idle threads pick the others meanwhile
+		epoll_event event = {};
+		int count = ::epoll_wait(m_epoll, &event, 1, -1);
+		if(count < 0 && errno == EINTR) {
+			continue;
+		}
+		if(count < 0 || event.data.u64 == stop_id) {
+			return;
+		}
+		if(count == 1) {
+			handle(event.data.u64);
+		}
+	}
+}
+
+void reactor::handle(uint64_t id)
+{
+	std::shared_ptr<registration> entry;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		auto it = m_registrations.find(id);
+		if(it == m_registrations.end() || it->second->removed) {
+			return;
+		}
+		entry = it->second;
+		entry->running = std::this_thread::get_id();
+		entry->busy = true;
+	}
+
+	finish(id, entry, entry->fn(false));
+}
+
+void reactor::handle_on_worker(uint64_t id, std::shared_ptr<registration> entry)
+{
+	bool removed = false;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		removed = entry->removed;
+		entry->running = std::this_thread::get_id();
+	}
+	// Removed while it waited for us (remove() wait for it), handler is not called anymore
+	finish(id, entry, removed ? handler_result::remove : entry->fn(true));
+}
+
+void reactor::finish(uint64_t id, const std::shared_ptr<registration>& entry, handler_result result)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	entry->running = std::thread::id();
+	if(!entry->removed && !m_stopping) {
+		if(result == handler_result::offload) {
+			// Handle stay not armed until worker is done, so frames are still handled in order
+			m_workers.post([this, id, entry]() {
+				handle_on_worker(id, entry);
+			});
+			return;
+		}
+		if(result == handler_result::rearm) {
+			// Armed again, next readiness is delivered to whichever thread wait
+			entry->busy = false;
+			epoll_event event = {};
+			event.events = EPOLLIN | EPOLLONESHOT;
+			event.data.u64 = id;
+			if(::epoll_ctl(m_epoll, EPOLL_CTL_MOD, entry->handle, &event) == 0) {
+				return;
+			}
+		}
+	}
+	::epoll_ctl(m_epoll, EPOLL_CTL_DEL, entry->handle, nullptr);
+	m_registrations.erase(id);
+	entry->busy = false;
+	m_handler_done.notify_all();
+}
+
+} // end of namespace ipc
+
+#endif // __linux__
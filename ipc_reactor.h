@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ipc_data.h"
+#include "ipc_dispatcher.h"
+
+#ifdef __linux__
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Event loop serving reads of many connections on fixed number of threads (epoll, Linux).
+// Connection which use it (flow_control::reactor) has no read thread, its handler is called when its read
+// handle become readable and it read what arrived. One connection is handled by one thread at a time
+// (EPOLLONESHOT, handle is armed again after handler), so frames of it are still handled in order.
+// Loop thread never wait: handler take only frames which arrived whole and run no user code, partial frame
+// wait in transport buffer for its rest. Frame which does not fit there (big payload, slow writer of it),
+// message callbacks (requests without dispatcher_threads, one-way messages) and continuations of responses
+// are left to worker threads, which may wait. Connection is not watched until its worker is done, busy
+// workers delay other such work.
+class reactor
+{
+public:
+	enum class handler_result {
+		rearm,     // Watch handle again
+		offload,   // Call handler again on worker thread, it may wait there
+		remove,    // Stop watching (connection ended)
+	};
+	// may_wait is false on loop thread
+	using handler_fn = std::function<handler_result(bool may_wait)>;
+
+	// Loop threads and the same number of worker threads
+	reactor(uint32_t threads);
+	~reactor();
+
+	reactor(const reactor&) = delete;
+	reactor& operator=(const reactor&) = delete;
+
+	// Watch handle, return registration id (0 on failure)
+	uint64_t add(native_handle handle, handler_fn fn);
+	// Run fn on worker thread (work loop thread must not do)
+	void post(dispatcher::work_fn fn) {
+		m_workers.post(std::move(fn));
+	}
+	// Stop watching, wait for running or offloaded handler (unless it is the caller)
+	void remove(uint64_t id);
+	// Stop and join threads, handlers are not called anymore (not from handler, as no read thread join itself).
+	// Handler waiting on worker hold it, connections should be released first
+	void stop();
+
+	// Number of loop threads
+	size_t threads() const {
+		return m_threads.size();
+	}
+
+private:
+	struct registration {
+		native_handle handle = invalid_handle;
+		handler_fn fn;
+		std::thread::id running;    // Thread calling handler now (empty when none)
+		bool busy = false;          // Handler run or wait for worker (handle is not armed)
+		bool removed = false;
+	};
+
+	void loop();
+	void handle(uint64_t id);
+	void handle_on_worker(uint64_t id, std::shared_ptr<registration> entry);
+	// Arm handle again, offload or drop registration by handler result
+	void finish(uint64_t id, const std::shared_ptr<registration>& entry, handler_result result);
+
+private:
+	int m_epoll = -1;
+	int m_stop_event = -1;          // eventfd, stay readable after stop so every thread see it
+	std::vector<std::thread> m_threads;
+	dispatcher m_workers;
+
+	std::mutex m_lock;
+	std::condition_variable m_handler_done;
+	std::unordered_map<uint64_t, std::shared_ptr<registration>> m_registrations;
+	uint64_t m_next_id = 1;
+	bool m_stopping = false;
+};
+
+} // end of namespace ipc
+
+#endif // __linux__
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+#include "ipc_stream.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Path from responder back to connection, closed when connection is released
+// (responder can outlive it)
+class response_channel
+{
+public:
+	using send_fn = std::function<bool(uint32_t id, bool streamed, std::vector<uint8_t>& response)>;
+	using stream_fn = std::function<std::shared_ptr<stream_writer>(uint32_t id)>;
+
+	response_channel(send_fn fn, stream_fn open_stream_fn = nullptr)
+		: m_send_fn(std::move(fn))
+		, m_stream_fn(std::move(open_stream_fn))
+	{}
+
+	bool send(uint32_t id, bool streamed, std::vector<uint8_t>& response) {
+		std::shared_lock<std::shared_mutex> guard(m_lock);
+		return m_send_fn ? m_send_fn(id, streamed, response) : false;
+	}
+
+	// Writer of response stream (streamed request)
+	std::shared_ptr<stream_writer> open_stream(uint32_t id) {
+		std::shared_lock<std::shared_mutex> guard(m_lock);
+		return m_stream_fn ? m_stream_fn(id) : nullptr;
+	}
+
+	// Wait for running sends, no send after this
+	void close() {
+		std::unique_lock<std::shared_mutex> guard(m_lock);
+		m_send_fn = nullptr;
+		m_stream_fn = nullptr;
+	}
+
+private:
+	std::shared_mutex m_lock;
+	send_fn m_send_fn;
+	stream_fn m_stream_fn;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Answer of one request, can be completed later from any thread.
+// Copies share one answer, only first respond() is sent. When last copy is destroyed
+// without answer, empty response is sent (so other side never wait forever).
+class responder
+{
+public:
+	responder() = default;
+	// streamed: request came by send_streamed (HEADER_FLAG_USER_MSG_STREAMED)
+	responder(std::weak_ptr<response_channel> channel, uint32_t id, bool streamed = false)
+		: m_state(std::make_shared<state>(std::move(channel), id, streamed))
+	{}
+
+	bool valid() const {
+		return m_state != nullptr;
+	}
+	uint32_t id() const {
+		return m_state ? m_state->id : 0;
+	}
+
+	// Send response, return false when already answered or connection is closed
+	bool respond(std::vector<uint8_t>& response) {
+		return m_state && m_state->respond(response);
+	}
+	bool respond(std::vector<uint8_t>&& response) {
+		return respond(response);
+	}
+
+	// Requester read response as stream of parts (send_streamed), respond() send single part then
+	bool streamed() const {
+		return m_state && m_state->streamed;
+	}
+	// Stream of partial responses of streamed request, closing it end the response (dropping it abort the response).
+	// Writes wait while requester is behind, so long streams must not be written from read thread.
+	// nullptr when request is not streamed, it is already answered or stream can not be opened (empty response is sent then)
+	std::shared_ptr<stream_writer> stream() {
+		return streamed() ? m_state->stream() : nullptr;
+	}
+
+private:
+	struct state {
+		std::weak_ptr<response_channel> channel;
+		uint32_t id = 0;
+		bool streamed = false;
+		std::atomic_bool answered = false;
+
+		state(std::weak_ptr<response_channel> response_channel, uint32_t message_id, bool streamed_request)
+			: channel(std::move(response_channel))
+			, id(message_id)
+			, streamed(streamed_request)
+		{}
+		~state() {
+			std::vector<uint8_t> no_response;
+			respond(no_response);
+		}
+
+		bool respond(std::vector<uint8_t>& response) {
+			if(answered.exchange(true)) {
+				return false;
+			}
+			std::shared_ptr<response_channel> target = channel.lock();
+			return target && target->send(id, streamed, response);
+		}
+
+		std::shared_ptr<stream_writer> stream() {
+			if(answered) {
+				return nullptr;
+			}
+			std::shared_ptr<response_channel> target = channel.lock();
+			std::shared_ptr<stream_writer> writer = target ? target->open_stream(id) : nullptr;
+			if(!writer) {
+				// Stream can not be opened, requester get empty response instead of waiting for it
+				std::vector<uint8_t> no_response;
+				respond(no_response);
+				return nullptr;
+			}
+			if(answered.exchange(true)) {
+				return nullptr;  // Answered meanwhile, dropped writer abort its stream
+			}
+			return writer;
+		}
+	};
+
+	std::shared_ptr<state> m_state;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Message callback with deferred response, it return immediately and answer later by reply.respond()
+using deferred_message_callback_fn = std::function<void(const std::vector<uint8_t>& message, responder reply)>;
+
+} // end of namespace ipc
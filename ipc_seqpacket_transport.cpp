@@ -0,0 +1,331 @@
+#include "stdafx.h"
+#include "ipc_seqpacket_transport.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace ipc {
+
+constexpr size_t max_datagram_parts = IOV_MAX;  // Longer gather list is joined first
+constexpr size_t max_send_batch = IOV_MAX;      // Datagrams sent by one sendmmsg
+
+seqpacket_transport::seqpacket_transport(client_connection& connection)
+	: m_socket(connection.socket)
+	, m_slots(new uint8_t[receive_batch * datagram_size])
+{
+	// We own socket now
+	connection.socket = invalid_handle;
+
+	for(size_t i = 0; i < receive_batch; i++) {
+		m_slot_iov[i].iov_base = m_slots.get() + i * datagram_size;
+		m_slot_iov[i].iov_len = datagram_size;
+		m_slot_messages[i].msg_hdr.msg_iov = &m_slot_iov[i];
+		m_slot_messages[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+seqpacket_transport::~seqpacket_transport()
+{
+	close_write();
+	close_read();
+}
+
+bool seqpacket_transport::create_pair(native_handle& master_end, native_handle& slave_end)
+{
+	return platform::create_socket_pair(master_end, slave_end, false, true, true);
+}
+
+bool seqpacket_transport::is_packet_socket(native_handle handle)
+{
+	int type = 0;
+	socklen_t length = sizeof(type);
+	return ::getsockopt(handle, SOL_SOCKET, SO_TYPE, &type, &length) == 0 && type == SOCK_SEQPACKET;
+}
+
+#pragma region Write
+platform::io_result seqpacket_transport::write_frame(const header& header_data, message_parts parts)
+{
+	std::vector<uint8_t> joined;
+	message_view joined_part;
+	if(parts.size() >= max_datagram_parts) {
+		// Datagram can not be gathered from so many parts, copy them into one
+		prepare_payload(joined, header_data.message_size);
+		for(const message_view& part : parts) {
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(part.data());
+			joined.insert(joined.end(), data, data + part.size());
+		}
+		joined_part = to_view(joined);
+		parts = message_parts(&joined_part, 1);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// Cut [header, parts...] into datagrams of datagram_size bytes (only the last one is shorter)
+	m_write_iov.clear();
+	m_write_messages.clear();
+	size_t datagram_left = datagram_size;
+	size_t datagram_iov = 0;
+	auto end_datagram = [&]() {
+		mmsghdr message = {};
+		message.msg_hdr.msg_iovlen = m_write_iov.size() - datagram_iov;
+		m_write_messages.push_back(message);
+		datagram_iov = m_write_iov.size();
+		datagram_left = datagram_size;
+	};
+	auto add = [&](const void* data, size_t size) {
+		uint8_t* ptr = static_cast<uint8_t*>(const_cast<void*>(data));
+		while(size > 0) {
+			size_t count = std::min(size, datagram_left);
+			m_write_iov.push_back({ptr, count});
+			ptr += count;
+			size -= count;
+			datagram_left -= count;
+			if(datagram_left == 0) {
+				end_datagram();
+			}
+		}
+	};
+	add(&header_data, sizeof(ipc::header));
+	for(const message_view& part : parts) {
+		add(part.data(), part.size());
+	}
+	if(datagram_iov < m_write_iov.size()) {
+		end_datagram();
+	}
+
+	// Vector does not move anymore, point datagrams to their iov ranges
+	iovec* iov = m_write_iov.data();
+	for(mmsghdr& message : m_write_messages) {
+		message.msg_hdr.msg_iov = iov;
+		iov += message.msg_hdr.msg_iovlen;
+	}
+
+	platform::io_result result = platform::io_result::ok;
+	size_t sent = 0;
+	while(sent < m_write_messages.size()) {
+		unsigned int count = static_cast<unsigned int>(std::min(m_write_messages.size() - sent, max_send_batch));
+		int sent_count = ::sendmmsg(m_socket, m_write_messages.data() + sent, count, MSG_NOSIGNAL);
+		if(sent_count < 0) {
+			if(errno == EINTR) continue;
+			result = (errno == EPIPE || errno == EBADF || errno == ECONNRESET || errno == ENOTCONN) ? platform::io_result::disconnected : platform::io_result::failed;
+			break;
+		}
+		sent += static_cast<size_t>(sent_count);
+	}
+	if(!joined.empty() && m_buffer_pool) {
+		m_buffer_pool->release(joined);
+	}
+	return result;
+}
+
+void seqpacket_transport::set_bulk_mode(uint32_t, uint32_t pipe_size)
+{
+	// Datagram must fit into socket send buffer, payload is always copied (no vmsplice into socket)
+	if(pipe_size) {
+		platform::set_socket_buffer_size(m_socket, std::max<size_t>(pipe_size, 2 * datagram_size));
+	}
+}
+
+void seqpacket_transport::close_write()
+{
+	// Other side get end of file after it read all datagrams, we can still read
+	platform::shutdown_write(m_socket);
+}
+#pragma endregion Write
+
+#pragma region Read
+platform::io_result seqpacket_transport::read_frame(header& header_data, std::vector<uint8_t>& payload)
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	platform::io_result result = read_first(header_data, data, size);
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	prepare_payload(payload, header_data.message_size);
+	payload.insert(payload.end(), data, data + size);
+	payload.resize(header_data.message_size);
+	return read_rest(payload.data() + size, header_data.message_size - size);
+}
+
+platform::io_result seqpacket_transport::read_frame_view(header& header_data, message_view& payload)
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	platform::io_result result = read_first(header_data, data, size);
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	if(size == header_data.message_size) {
+		// Whole frame is one datagram, payload point into receive slot
+		payload = message_view(reinterpret_cast<const std::byte*>(data), size);
+		return platform::io_result::ok;
+	}
+
+	prepare_payload(m_view_buffer, header_data.message_size);
+	m_view_buffer.insert(m_view_buffer.end(), data, data + size);
+	m_view_buffer.resize(header_data.message_size);
+	payload = to_view(m_view_buffer);
+	return read_rest(m_view_buffer.data() + size, header_data.message_size - size);
+}
+
+platform::io_result seqpacket_transport::read_first(header& header_data, const uint8_t*& data, size_t& size)
+{
+	platform::io_result result = next_datagram(data, size);
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	if(size < sizeof(header)) {
+		return platform::io_result::failed;
+	}
+	::memcpy(&header_data, data, sizeof(header));
+	data += sizeof(header);
+	size -= sizeof(header);
+	if(header_data.message_size > m_max_message_size || size > header_data.message_size) {
+		return platform::io_result::failed;
+	}
+	// Only full datagram is continued
+	if(size < header_data.message_size && size + sizeof(header) != datagram_size) {
+		return platform::io_result::failed;
+	}
+	return platform::io_result::ok;
+}
+
+platform::io_result seqpacket_transport::read_rest(uint8_t* data, size_t size)
+{
+	// Continuation received together with previous datagrams
+	while(size > 0 && m_slot_next < m_slot_count) {
+		const uint8_t* datagram = nullptr;
+		size_t datagram_bytes = 0;
+		platform::io_result result = next_datagram(datagram, datagram_bytes);
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+		if(datagram_bytes != std::min(size, datagram_size)) {
+			return platform::io_result::failed;
+		}
+		::memcpy(data, datagram, datagram_bytes);
+		data += datagram_bytes;
+		size -= datagram_bytes;
+	}
+
+	// Rest is received straight into its place (datagram sizes are known)
+	mmsghdr messages[receive_batch];
+	iovec iov[receive_batch];
+	while(size > 0) {
+		size_t count = 0;
+		for(size_t offset = 0; count < receive_batch && offset < size; offset += datagram_size, count++) {
+			iov[count].iov_base = data + offset;
+			iov[count].iov_len = std::min(size - offset, datagram_size);
+			messages[count] = {};
+			messages[count].msg_hdr.msg_iov = &iov[count];
+			messages[count].msg_hdr.msg_iovlen = 1;
+		}
+		platform::io_result result = platform::io_result::ok;
+		size_t received = receive(messages, count, result);
+		for(size_t i = 0; i < received; i++) {
+			if(messages[i].msg_len == 0) {
+				return platform::io_result::disconnected;
+			}
+			if(messages[i].msg_len != iov[i].iov_len || (messages[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+				return platform::io_result::failed;
+			}
+			data += messages[i].msg_len;
+			size -= messages[i].msg_len;
+		}
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+	return platform::io_result::ok;
+}
+
+frame_state seqpacket_transport::poll_frame(header& header_data)
+{
+	if(m_slot_next == m_slot_count) {
+		platform::io_result result = platform::io_result::ok;
+		size_t received = receive(m_slot_messages, receive_batch, result, MSG_DONTWAIT);
+		if(result != platform::io_result::ok) {
+			return frame_state::unbuffered;  // Read report it
+		}
+		if(received == 0) {
+			return frame_state::partial;
+		}
+		m_slot_next = 0;
+		m_slot_count = received;
+	}
+
+	const mmsghdr& message = m_slot_messages[m_slot_next];
+	if(message.msg_len < sizeof(header) || (message.msg_hdr.msg_flags & MSG_TRUNC)) {
+		return frame_state::unbuffered;
+	}
+	::memcpy(&header_data, m_slots.get() + m_slot_next * datagram_size, sizeof(header));
+	// Whole when its continuation datagrams came by the same receive
+	size_t datagrams = (sizeof(header) + static_cast<size_t>(header_data.message_size) + datagram_size - 1) / datagram_size;
+	return (m_slot_count - m_slot_next >= datagrams) ? frame_state::complete : frame_state::unbuffered;
+}
+
+platform::io_result seqpacket_transport::next_datagram(const uint8_t*& data, size_t& size)
+{
+	if(m_slot_next == m_slot_count) {
+		platform::io_result result = platform::io_result::ok;
+		m_slot_next = 0;
+		m_slot_count = receive(m_slot_messages, receive_batch, result);
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+
+	size_t index = m_slot_next++;
+	const mmsghdr& message = m_slot_messages[index];
+	if(message.msg_len == 0) {
+		return platform::io_result::disconnected; // End of file (other side closed, or we were woken up)
+	}
+	if(message.msg_hdr.msg_flags & MSG_TRUNC) {
+		return platform::io_result::failed;
+	}
+	data = m_slots.get() + index * datagram_size;
+	size = message.msg_len;
+	return platform::io_result::ok;
+}
+
+size_t seqpacket_transport::receive(mmsghdr* messages, size_t count, platform::io_result& result, int flags)
+{
+	while(true) {
+		// Block until first datagram, take what else is there
+		int received = ::recvmmsg(m_socket, messages, static_cast<unsigned int>(count), flags, nullptr);
+		if(received > 0) {
+			result = platform::io_result::ok;
+			return static_cast<size_t>(received);
+		}
+		if(received < 0 && errno == EINTR) continue;
+		if(received < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			result = platform::io_result::ok;
+			return 0;
+		}
+		result = (received == 0 || errno == EBADF || errno == ECONNRESET || errno == ENOTCONN) ? platform::io_result::disconnected : platform::io_result::failed;
+		return 0;
+	}
+}
+
+void seqpacket_transport::close_read()
+{
+	platform::close_handle(m_socket);
+}
+
+void seqpacket_transport::wakeup()
+{
+	// Blocked receive return end of file (socket stay blocking, no poll per read)
+	if(m_socket != invalid_handle) {
+		::shutdown(m_socket, SHUT_RD);
+	}
+}
+#pragma endregion Read
+
+} // end of namespace ipc
+
+#endif // __linux__
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ipc_transport.h"
+
+#ifdef __linux__
+
+#include <sys/socket.h>
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Unix domain SOCK_SEQPACKET transport, kernel keep message boundaries, so frame is datagram
+// (header + payload by one sendmsg, read by one recvmsg, no reassembly from byte stream).
+// Frame bigger than datagram_size continue by full datagrams (last one shorter), all of them are sent by one
+// sendmmsg and received straight into payload. Small frames are received in batches by recvmmsg.
+class seqpacket_transport : public transport
+{
+public:
+	static constexpr size_t datagram_size = 64 * 1024;  // Both sides must use the same (frame is split by it)
+	static constexpr size_t receive_batch = 16;         // Datagrams received by one recvmmsg
+
+	seqpacket_transport(client_connection& connection);
+	~seqpacket_transport();
+
+	// Create socket pair (master side), master_end is not inherited, slave_end is inherited by child
+	static bool create_pair(native_handle& master_end, native_handle& slave_end);
+	// Socket keep message boundaries (is SOCK_SEQPACKET)
+	static bool is_packet_socket(native_handle handle);
+
+	//! \copydoc transport::write_frame
+	platform::io_result write_frame(const header& header_data, message_parts parts) override;
+	using transport::write_frame;
+	//! \copydoc transport::read_frame
+	platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) override;
+	//! \copydoc transport::read_frame_view
+	platform::io_result read_frame_view(header& header_data, message_view& payload) override;
+	//! \copydoc transport::set_bulk_mode
+	void set_bulk_mode(uint32_t bulk_threshold, uint32_t pipe_size) override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+	//! \copydoc transport::wakeup
+	void wakeup() override;
+	//! \copydoc transport::read_handle
+	native_handle read_handle() const override {
+		return m_socket;
+	}
+	//! \copydoc transport::poll_frame
+	frame_state poll_frame(header& header_data) override;
+
+private:
+	// Next received datagram (receive batch when none is left), valid until next call
+	platform::io_result next_datagram(const uint8_t*& data, size_t& size);
+	// First datagram of frame, header is copied out, rest is first part of payload
+	platform::io_result read_first(header& header_data, const uint8_t*& data, size_t& size);
+	// Continuation datagrams of frame (already received ones first, rest straight into payload)
+	platform::io_result read_rest(uint8_t* data, size_t size);
+
+	// Receive datagrams (block for the first one only), return number of them, 0 on error (result is set)
+	// or when none is there and MSG_DONTWAIT is given
+	size_t receive(mmsghdr* messages, size_t count, platform::io_result& result, int flags = MSG_WAITFORONE);
+
+private:
+	native_handle m_socket = invalid_handle;
+
+	// Write side (serialized by caller), gather list cut into datagrams, kept to not allocate every frame
+	std::vector<iovec> m_write_iov;
+	std::vector<mmsghdr> m_write_messages;
+
+	// Read side
+	std::unique_ptr<uint8_t[]> m_slots;     // receive_batch slots of datagram_size bytes (not touched until used)
+	mmsghdr m_slot_messages[receive_batch] = {};
+	iovec m_slot_iov[receive_batch] = {};
+	size_t m_slot_next = 0;                 // First not consumed slot
+	size_t m_slot_count = 0;                // Slots filled by last receive
+};
+
+} // end of namespace ipc
+
+#endif // __linux__
@@ -0,0 +1,442 @@
+#include "stdafx.h"
+#include "ipc_shm_transport.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace ipc {
+
+constexpr uint32_t shm_magic = 0x31435049; // "IPC1"
+constexpr auto shm_spin_time = std::chrono::microseconds(50);    // Busy wait before we go to sleep
+constexpr int shm_liveness_check_ms = 100;                       // How often sleeping side check that other side is alive
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory ring require lock free atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared memory ring require lock free atomics");
+
+//////////////////////////////////////////////////////////////////////////
+// Shared memory layout
+struct shm_ring {
+	alignas(64) std::atomic<uint64_t> head;              // Producer position (bytes written)
+	alignas(64) std::atomic<uint64_t> tail;              // Consumer position (bytes read)
+	alignas(64) std::atomic<uint32_t> consumer_waiting;  // Futex, consumer sleeps on empty ring
+	std::atomic<uint32_t> producer_waiting;              // Futex, producer sleeps on full ring
+	std::atomic<uint32_t> closed;                        // Producer will not write anymore
+};
+
+struct shm_layout {
+	uint32_t magic;
+	uint32_t ring_size;
+	shm_ring rings[2];   // [0] master->slave, [1] slave->master
+	// Followed by ring data (rings[0] data, rings[1] data)
+};
+
+static uint8_t* ring_data(shm_layout* layout, int index)
+{
+	return reinterpret_cast<uint8_t*>(layout) + sizeof(shm_layout) + static_cast<size_t>(index) * layout->ring_size;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Futex helpers (not FUTEX_PRIVATE, word is shared between processes)
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t value, int timeout_ms)
+{
+	timespec timeout;
+	timeout.tv_sec = timeout_ms / 1000;
+	timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word)
+{
+	::syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+static void wake_if_waiting(std::atomic<uint32_t>* word)
+{
+	if(word->load() != 0 && word->exchange(0) != 0) {
+		futex_wake(word);
+	}
+}
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+template<class Predicate>
+static bool spin_until(Predicate predicate)
+{
+	// On single CPU spinning only steal time from the other side
+	static const bool spin_enabled = std::thread::hardware_concurrency() > 1;
+	if(!spin_enabled) {
+		return predicate();
+	}
+
+	auto spin_end = std::chrono::steady_clock::now() + shm_spin_time;
+	do {
+		for(int i = 0; i < 64; i++) {
+			if(predicate()) return true;
+			cpu_relax();
+		}
+	} while(std::chrono::steady_clock::now() < spin_end);
+	return predicate();
+}
+
+#pragma region Create
+bool shm_transport::create_section(native_handle& master_end, native_handle& slave_end, uint32_t ring_size)
+{
+	if(ring_size == 0 || (ring_size & (ring_size - 1)) != 0) {
+		errno = EINVAL;
+		return false;
+	}
+
+	int fd = ::memfd_create("ipc_comm", MFD_CLOEXEC);
+	if(fd < 0) {
+		return false;
+	}
+
+	size_t mapping_size = sizeof(shm_layout) + 2 * static_cast<size_t>(ring_size);
+	if(::ftruncate(fd, static_cast<off_t>(mapping_size)) != 0) {
+		platform::close_handle(fd);
+		return false;
+	}
+
+	void* mapping = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(mapping == MAP_FAILED) {
+		platform::close_handle(fd);
+		return false;
+	}
+	// Memory is zeroed by ftruncate, so all positions and flags are 0
+	shm_layout* layout = new(mapping) shm_layout;
+	layout->ring_size = ring_size;
+	layout->magic = shm_magic;
+	::munmap(mapping, mapping_size);
+
+	// dup() does not copy FD_CLOEXEC, so slave end survive exec
+	slave_end = ::dup(fd);
+	if(slave_end < 0) {
+		slave_end = invalid_handle;
+		platform::close_handle(fd);
+		return false;
+	}
+	master_end = fd;
+	return true;
+}
+
+shm_transport::shm_transport(client_connection& connection, bool master_side)
+	: m_connection(connection)
+{
+	// We own handles now
+	connection.read_pipe = invalid_handle;
+	connection.write_pipe = invalid_handle;
+	connection.shared_memory = invalid_handle;
+	// Destructor does not run when we throw, owned handles are closed here then
+	auto fail = [&](const std::string& message) {
+		platform::close_handle(m_connection.shared_memory);
+		platform::close_handle(m_connection.read_pipe);
+		platform::close_handle(m_connection.write_pipe);
+		throw std::runtime_error(message);
+	};
+
+	struct stat section_stat;
+	if(::fstat(m_connection.shared_memory, &section_stat) != 0 || section_stat.st_size < static_cast<off_t>(sizeof(shm_layout))) {
+		fail("Invalid shared memory section");
+	}
+	m_mapping_size = static_cast<size_t>(section_stat.st_size);
+
+	void* mapping = ::mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_connection.shared_memory, 0);
+	if(mapping == MAP_FAILED) {
+		fail("Map shared memory fail: " + platform::error_to_ansi(platform::last_error()));
+	}
+	// Mapping hold the section, handle is not needed anymore
+	platform::close_handle(m_connection.shared_memory);
+
+	m_layout = static_cast<shm_layout*>(mapping);
+	if(m_layout->magic != shm_magic || sizeof(shm_layout) + 2 * static_cast<size_t>(m_layout->ring_size) > m_mapping_size) {
+		::munmap(m_layout, m_mapping_size);
+		m_layout = nullptr;
+		fail("Invalid shared memory section");
+	}
+	m_ring_mask = m_layout->ring_size - 1;
+
+	int write_index = master_side ? 0 : 1;
+	int read_index = master_side ? 1 : 0;
+	m_write_ring = &m_layout->rings[write_index];
+	m_write_data = ring_data(m_layout, write_index);
+	m_write_pos = m_write_ring->head.load();
+	m_read_ring = &m_layout->rings[read_index];
+	m_read_data = ring_data(m_layout, read_index);
+	m_read_pos = m_read_ring->tail.load();
+}
+
+shm_transport::~shm_transport()
+{
+	close_write();
+	close_read();
+	if(m_layout) {
+		::munmap(m_layout, m_mapping_size);
+		m_layout = nullptr;
+	}
+}
+#pragma endregion Create
+
+bool shm_transport::peer_alive() const
+{
+	// Nobody write into pipe, so the only event we can get is hang-up (other side closed write pipe or died)
+	if(m_connection.read_pipe == invalid_handle) {
+		return false;
+	}
+	pollfd fd = { m_connection.read_pipe, POLLIN, 0 };
+	if(::poll(&fd, 1, 0) > 0 && (fd.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+		return false;
+	}
+	return true;
+}
+
+#pragma region Write
+platform::io_result shm_transport::write_frame(const header& header_data, message_parts parts)
+{
+	if(m_write_ring->closed.load()) {
+		return platform::io_result::disconnected;
+	}
+
+	platform::io_result result = write_bytes(&header_data, sizeof(header));
+	for(const message_view& part : parts) {
+		if(result != platform::io_result::ok) break;
+		if(!part.empty()) {
+			result = write_bytes(part.data(), part.size());
+		}
+	}
+	// Publish whole frame at once, so reader never wake up on header only
+	publish_write();
+	return result;
+}
+
+platform::io_result shm_transport::write_bytes(const void* data, size_t size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	const uint64_t ring_size = m_layout->ring_size;
+
+	while(size > 0) {
+		uint64_t free_bytes = ring_size - (m_write_pos - m_write_ring->tail.load(std::memory_order_acquire));
+		if(free_bytes == 0) {
+			// Frame is bigger than free space, let reader consume what we have
+			publish_write();
+			platform::io_result result = wait_for_space();
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+			continue;
+		}
+
+		size_t count = static_cast<size_t>(std::min<uint64_t>(free_bytes, size));
+		size_t offset = static_cast<size_t>(m_write_pos & m_ring_mask);
+		size_t first = std::min<size_t>(count, static_cast<size_t>(ring_size) - offset);
+		::memcpy(m_write_data + offset, src, first);
+		::memcpy(m_write_data, src + first, count - first);
+
+		m_write_pos += count;
+		src += count;
+		size -= count;
+	}
+	return platform::io_result::ok;
+}
+
+void shm_transport::publish_write()
+{
+	m_write_ring->head.store(m_write_pos);
+	wake_if_waiting(&m_write_ring->consumer_waiting);
+}
+
+platform::io_result shm_transport::wait_for_space()
+{
+	const uint64_t ring_size = m_layout->ring_size;
+	auto has_space = [&]() {
+		return m_write_pos - m_write_ring->tail.load(std::memory_order_acquire) < ring_size;
+	};
+
+	if(spin_until(has_space)) {
+		return platform::io_result::ok;
+	}
+
+	while(true) {
+		m_write_ring->producer_waiting.store(1);
+		if(has_space()) {
+			m_write_ring->producer_waiting.store(0);
+			return platform::io_result::ok;
+		}
+		futex_wait(&m_write_ring->producer_waiting, 1, shm_liveness_check_ms);
+		if(!has_space() && !peer_alive()) {
+			return platform::io_result::disconnected;
+		}
+	}
+}
+
+void shm_transport::close_write()
+{
+	if(m_write_ring && !m_write_ring->closed.exchange(1)) {
+		m_write_ring->consumer_waiting.store(0);
+		futex_wake(&m_write_ring->consumer_waiting);
+	}
+	platform::close_handle(m_connection.write_pipe);
+}
+#pragma endregion Write
+
+#pragma region Read
+platform::io_result shm_transport::read_frame(header& header_data, std::vector<uint8_t>& payload)
+{
+	platform::io_result result = read_bytes(&header_data, sizeof(header));
+	if(result == platform::io_result::ok && header_data.message_size > m_max_message_size) {
+		result = platform::io_result::failed;
+	}
+	if(result == platform::io_result::ok) {
+		prepare_payload(payload, header_data.message_size);
+		payload.resize(header_data.message_size);
+		if(header_data.message_size > 0) {
+			result = read_bytes(payload.data(), header_data.message_size);
+		}
+	}
+	publish_read();
+	return result;
+}
+
+platform::io_result shm_transport::read_frame_view(header& header_data, message_view& payload)
+{
+	platform::io_result result = read_bytes(&header_data, sizeof(header));
+	if(result == platform::io_result::ok && header_data.message_size > m_max_message_size) {
+		result = platform::io_result::failed;
+	}
+	if(result != platform::io_result::ok) {
+		publish_read();
+		return result;
+	}
+
+	const size_t size = header_data.message_size;
+	const size_t offset = static_cast<size_t>(m_read_pos & m_ring_mask);
+	if(size > m_layout->ring_size - offset) {
+		// Payload wrap around ring end, copy it
+		prepare_payload(m_view_buffer, size);
+		m_view_buffer.resize(size);
+		result = read_bytes(m_view_buffer.data(), size);
+		publish_read();
+		payload = to_view(m_view_buffer);
+		return result;
+	}
+
+	// Payload is contiguous in ring, wait until writer published all of it and point into ring,
+	// its space is given back to writer by release_frame
+	publish_read();
+	if(size > 0 && m_read_ring->head.load(std::memory_order_acquire) - m_read_pos < size) {
+		result = wait_for_data(size);
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+	payload = message_view(reinterpret_cast<const std::byte*>(m_read_data + offset), size);
+	m_read_pos += size;
+	return platform::io_result::ok;
+}
+
+void shm_transport::release_frame()
+{
+	publish_read();
+	transport::release_frame();
+}
+
+platform::io_result shm_transport::read_bytes(void* data, size_t size)
+{
+	uint8_t* dst = static_cast<uint8_t*>(data);
+	const uint64_t ring_size = m_layout->ring_size;
+
+	while(size > 0) {
+		uint64_t available = m_read_ring->head.load(std::memory_order_acquire) - m_read_pos;
+		if(available == 0) {
+			// Give space back to writer before we wait
+			publish_read();
+			platform::io_result result = wait_for_data();
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+			continue;
+		}
+
+		size_t count = static_cast<size_t>(std::min<uint64_t>(available, size));
+		size_t offset = static_cast<size_t>(m_read_pos & m_ring_mask);
+		size_t first = std::min<size_t>(count, static_cast<size_t>(ring_size) - offset);
+		::memcpy(dst, m_read_data + offset, first);
+		::memcpy(dst + first, m_read_data, count - first);
+
+		m_read_pos += count;
+		dst += count;
+		size -= count;
+	}
+	return platform::io_result::ok;
+}
+
+void shm_transport::publish_read()
+{
+	m_read_ring->tail.store(m_read_pos);
+	wake_if_waiting(&m_read_ring->producer_waiting);
+}
+
+platform::io_result shm_transport::wait_for_data(uint64_t min_bytes)
+{
+	auto has_data = [&]() {
+		return m_read_ring->head.load(std::memory_order_acquire) - m_read_pos >= min_bytes;
+	};
+
+	if(spin_until(has_data)) {
+		return platform::io_result::ok;
+	}
+
+	while(true) {
+		m_read_ring->consumer_waiting.store(1);
+		if(has_data()) {
+			m_read_ring->consumer_waiting.store(0);
+			return platform::io_result::ok;
+		}
+		if(m_read_ring->closed.load()) {
+			// Writer publish all data before it close ring
+			return has_data() ? platform::io_result::ok : platform::io_result::disconnected;
+		}
+		if(m_woken.load()) {
+			return platform::io_result::disconnected;
+		}
+		futex_wait(&m_read_ring->consumer_waiting, 1, shm_liveness_check_ms);
+		if(!has_data() && !peer_alive()) {
+			return platform::io_result::disconnected;
+		}
+	}
+}
+
+void shm_transport::close_read()
+{
+	platform::close_handle(m_connection.read_pipe);
+}
+
+void shm_transport::wakeup()
+{
+	// Waiting word is cleared before wake, so reader which is just going to sleep does not sleep
+	m_woken.store(true);
+	if(m_read_ring) {
+		m_read_ring->consumer_waiting.store(0);
+		futex_wake(&m_read_ring->consumer_waiting);
+	}
+}
+#pragma endregion Read
+
+} // end of namespace ipc
+
+#endif // __linux__
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ipc_transport.h"
+
+#ifdef __linux__
+
+namespace ipc {
+
+struct shm_layout;
+struct shm_ring;
+
+//////////////////////////////////////////////////////////////////////////
+// Shared memory transport, master and slave share two single-producer/single-consumer
+// ring buffers (master->slave and slave->master) in one memfd mapping.
+// Frames are stored as byte stream (header + payload, wrapping around ring end),
+// futex is used only to wake up sleeping side. Pipes from connection are kept only
+// to detect that the other side died (POLLHUP on read pipe).
+class shm_transport : public transport
+{
+public:
+	static constexpr uint32_t default_ring_size = 1 << 20; // Must be power of two
+
+	shm_transport(client_connection& connection, bool master_side);
+	~shm_transport();
+
+	// Create shared memory section (master side), master_end is not inherited, slave_end is inherited by child
+	static bool create_section(native_handle& master_end, native_handle& slave_end, uint32_t ring_size = default_ring_size);
+
+	//! \copydoc transport::write_frame
+	platform::io_result write_frame(const header& header_data, message_parts parts) override;
+	using transport::write_frame;
+	//! \copydoc transport::read_frame
+	platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) override;
+	//! \copydoc transport::read_frame_view
+	platform::io_result read_frame_view(header& header_data, message_view& payload) override;
+	//! \copydoc transport::release_frame
+	void release_frame() override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+	//! \copydoc transport::wakeup
+	void wakeup() override;
+
+private:
+	// Producer side
+	platform::io_result write_bytes(const void* data, size_t size);
+	void publish_write();
+	platform::io_result wait_for_space();
+
+	// Consumer side
+	platform::io_result read_bytes(void* data, size_t size);
+	void publish_read();
+	platform::io_result wait_for_data(uint64_t min_bytes = 1);
+
+	bool peer_alive() const;
+
+private:
+	client_connection m_connection;
+	shm_layout* m_layout = nullptr;
+	size_t m_mapping_size = 0;
+	uint64_t m_ring_mask = 0;
+
+	shm_ring* m_write_ring = nullptr;  // We are producer
+	uint8_t* m_write_data = nullptr;
+	uint64_t m_write_pos = 0;          // Local head (not yet published)
+
+	shm_ring* m_read_ring = nullptr;   // We are consumer
+	uint8_t* m_read_data = nullptr;
+	uint64_t m_read_pos = 0;           // Local tail (not yet published)
+	std::atomic<bool> m_woken = false; // Set by wakeup(), reader does not wait anymore
+};
+
+} // end of namespace ipc
+
+#endif // __linux__
@@ -8,21 +8,63 @@
 
 namespace ipc {
 
-std::shared_ptr<slave_intf> slave::factory::create_slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn) const
+std::shared_ptr<slave_intf> slave::factory::create_slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn, const flow_control& flow) const
 {
-	return std::make_shared<slave>(logger, connection, callback_fn);
+	return std::make_shared<slave>(logger, connection, callback_fn, flow);
 }
 
-slave::slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn)
-	: common(logger, callback_fn)
+std::shared_ptr<slave_intf> slave::factory::create_slave(logger_ptr logger, client_connection& connection, coro_message_callback_fn callback_fn, const flow_control& flow) const
 {
-	if(connection.read_pipe == nullptr) {
-		std::exception("Invalid read pipe handle");
-	}
-	if(connection.write_pipe == nullptr) {
-		std::exception("Invalid write pipe handle");
+	return std::make_shared<slave>(logger, connection, callback_fn, flow);
+}
+
+std::shared_ptr<slave_intf> slave::factory::create_slave(logger_ptr logger, client_connection& connection, deferred_message_callback_fn callback_fn, const flow_control& flow) const
+{
+	return std::make_shared<slave>(logger, connection, callback_fn, flow);
+}
+
+std::shared_ptr<slave_intf> slave::factory::create_slave(logger_ptr logger, client_connection& connection, view_message_callback_fn callback_fn, const flow_control& flow) const
+{
+	return std::make_shared<slave>(logger, connection, callback_fn, flow);
+}
+
+slave::slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+{
+	initialize(connection);
+}
+
+slave::slave(logger_ptr logger, client_connection& connection, coro_message_callback_fn callback_fn, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+{
+	initialize(connection);
+}
+
+slave::slave(logger_ptr logger, client_connection& connection, deferred_message_callback_fn callback_fn, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+{
+	initialize(connection);
+}
+
+slave::slave(logger_ptr logger, client_connection& connection, view_message_callback_fn callback_fn, const flow_control& flow)
+	: common(logger, callback_fn, flow)
+{
+	initialize(connection);
+}
+
+void slave::initialize(client_connection& connection)
+{
+	// Socket (or in-process loopback) carry both directions, pipes are not needed then
+	if(connection.socket == invalid_handle && !connection.loopback) {
+		if(connection.read_pipe == invalid_handle) {
+			throw std::runtime_error("Invalid read pipe handle");
+		}
+		if(connection.write_pipe == invalid_handle) {
+			throw std::runtime_error("Invalid write pipe handle");
+		}
 	}
-	start_communication(connection);
+	transport::factory transport_factory;
+	start_communication(transport_factory.create_transport(connection, false));
 }
 
 bool slave::send(std::vector<uint8_t>& message, std::vector<uint8_t>& response)
@@ -30,9 +72,54 @@ bool slave::send(std::vector<uint8_t>& message, std::vector<uint8_t>& response)
 	return common::send(message, response);
 }
 
+async_response slave::send_async(const std::vector<uint8_t>& message)
+{
+	return common::send_async(message);
+}
+
+bool slave::post(const std::vector<uint8_t>& message)
+{
+	return common::post(message);
+}
+
+async_response slave::send_async(message_parts message)
+{
+	return common::send_async(message);
+}
+
+bool slave::post(message_parts message)
+{
+	return common::post(message);
+}
+
+std::shared_ptr<stream_writer> slave::open_stream(message_view metadata)
+{
+	return common::open_stream(metadata);
+}
+
+std::shared_ptr<stream_reader> slave::accept_stream(uint32_t timeout_ms)
+{
+	return common::accept_stream(timeout_ms);
+}
+
+std::shared_ptr<stream_reader> slave::send_streamed(message_parts message)
+{
+	return common::send_streamed(message);
+}
+
+buffer_pool::statistics slave::buffer_pool_stats()
+{
+	return common::buffer_pool_stats();
+}
+
 void slave::stop()
 {
 	close_communication();
 }
 
+void slave::wait()
+{
+	wait_for_close();
+}
+
 } // end of namespace ipc
\ No newline at end of file
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <windows.h>
 #include "ipc_data.h"
 #include "ipc_slave_intf.h"
 #include "ipc_common.h"
@@ -12,16 +11,47 @@ class slave
 	, protected common
 {
 public:
-	slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn);
+	slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	slave(logger_ptr logger, client_connection& connection, coro_message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	slave(logger_ptr logger, client_connection& connection, deferred_message_callback_fn callback_fn, const flow_control& flow = flow_control());
+	slave(logger_ptr logger, client_connection& connection, view_message_callback_fn callback_fn, const flow_control& flow = flow_control());
 
 	struct factory {
-		virtual std::shared_ptr<slave_intf> create_slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn) const;
+		virtual std::shared_ptr<slave_intf> create_slave(logger_ptr logger, client_connection& connection, message_callback_fn callback_fn, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<slave_intf> create_slave(logger_ptr logger, client_connection& connection, coro_message_callback_fn callback_fn, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<slave_intf> create_slave(logger_ptr logger, client_connection& connection, deferred_message_callback_fn callback_fn, const flow_control& flow = flow_control()) const;
+		virtual std::shared_ptr<slave_intf> create_slave(logger_ptr logger, client_connection& connection, view_message_callback_fn callback_fn, const flow_control& flow = flow_control()) const;
 	};
 
 	//! \copydoc slave_intf::send
 	bool send(std::vector<uint8_t>& message, std::vector<uint8_t>& response) override;
+	//! \copydoc slave_intf::send_async
+	async_response send_async(const std::vector<uint8_t>& message) override;
+	//! \copydoc slave_intf::post
+	bool post(const std::vector<uint8_t>& message) override;
+	//! \copydoc slave_intf::send_async(message_parts)
+	async_response send_async(message_parts message) override;
+	//! \copydoc slave_intf::post(message_parts)
+	bool post(message_parts message) override;
+	using slave_intf::send;
+	using slave_intf::send_async;
+	using slave_intf::post;
+	//! \copydoc slave_intf::open_stream
+	std::shared_ptr<stream_writer> open_stream(message_view metadata) override;
+	//! \copydoc slave_intf::accept_stream
+	std::shared_ptr<stream_reader> accept_stream(uint32_t timeout_ms = platform::wait_infinite) override;
+	//! \copydoc slave_intf::send_streamed(message_parts)
+	std::shared_ptr<stream_reader> send_streamed(message_parts message) override;
+	using slave_intf::send_streamed;
+	//! \copydoc slave_intf::buffer_pool_stats
+	buffer_pool::statistics buffer_pool_stats() override;
 	//! \copydoc slave_intf::stop
 	void stop() override;
+	//! \copydoc slave_intf::wait
+	void wait() override;
+
+private:
+	void initialize(client_connection& connection);
 };
 
 } // end of namespace ipc
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <span>
 #include <string>
 #include <vector>
+#include "ipc_data.h"
+#include "ipc_coro.h"
+#include "ipc_responder.h"
+#include "ipc_stream.h"
 
 namespace ipc {
 
@@ -9,7 +14,54 @@ class slave_intf
 {
 public:
 	virtual bool send(std::vector<uint8_t>& message, std::vector<uint8_t>& response) = 0;
+	// Send message without waiting for response, many messages can be in flight over one connection
+	virtual async_response send_async(const std::vector<uint8_t>& message) = 0;
+	// One-way message, no response (callback response is dropped), return false when it can not be written
+	virtual bool post(const std::vector<uint8_t>& message) = 0;
+
+	// Message gathered from parts (written by one gathered write, parts are not joined into one buffer)
+	virtual async_response send_async(message_parts message) = 0;
+	virtual bool post(message_parts message) = 0;
+	async_response send_async(message_view message) {
+		return send_async(message_parts(&message, 1));
+	}
+	bool post(message_view message) {
+		return post(message_parts(&message, 1));
+	}
+	// Response buffer is moved out (swapped with caller one), payload is copied only once (by transport)
+	bool send(message_parts message, std::vector<uint8_t>& response) {
+		return send_async(message).get(response);
+	}
+	bool send(message_view message, std::vector<uint8_t>& response) {
+		return send(message_parts(&message, 1), response);
+	}
+	// Response is copied into caller buffer, response_size is response size (false also when buffer is too small)
+	bool send(message_view message, std::span<std::byte> response, size_t& response_size) {
+		return send_async(message).get(response, response_size);
+	}
+	// Stream of any length to other side (sent in chunks, write wait while reader is behind), metadata is given
+	// to reader, nullptr when communication ended
+	virtual std::shared_ptr<stream_writer> open_stream(message_view metadata) = 0;
+	// Next stream opened by other side (block until it is opened), nullptr on timeout or when communication ended
+	virtual std::shared_ptr<stream_reader> accept_stream(uint32_t timeout_ms = platform::wait_infinite) = 0;
+	// Request answered by stream of partial responses (handler write them by responder::stream()), parts are read
+	// as they come, `for(auto& part : *slave->send_streamed(message))`, nullptr when it can not be written
+	virtual std::shared_ptr<stream_reader> send_streamed(message_parts message) = 0;
+	std::shared_ptr<stream_reader> send_streamed(message_view message) {
+		return send_streamed(message_parts(&message, 1));
+	}
+	std::shared_ptr<stream_reader> send_streamed(const std::vector<uint8_t>& message) {
+		return send_streamed(to_view(message));
+	}
+	// Message buffer pool counters (hits mean no allocation)
+	virtual buffer_pool::statistics buffer_pool_stats() = 0;
+	// Awaitable send_async, `auto response = co_await master->request(message);`
+	request_awaitable request(const std::vector<uint8_t>& message) {
+		return request_awaitable(send_async(message));
+	}
 	virtual void stop() = 0;
+	// Block until communication ends (master disconnected or stop called)
+	virtual void wait() = 0;
 };
 
 } // end of namespace ipc
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "ipc_socket_transport.h"
+
+#ifndef _WIN32
+
+namespace ipc {
+
+socket_transport::socket_transport(client_connection& connection)
+	: pipe_transport(connection.socket, connection.socket)
+{
+	// We own socket now
+	connection.socket = invalid_handle;
+}
+
+socket_transport::~socket_transport()
+{
+	// Base destructor would close the one handle twice
+	close_write();
+	close_read();
+}
+
+bool socket_transport::create_pair(native_handle& master_end, native_handle& slave_end)
+{
+	return platform::create_socket_pair(master_end, slave_end, false, true);
+}
+
+void socket_transport::set_bulk_mode(uint32_t, uint32_t pipe_size)
+{
+	// Socket does not take pages by vmsplice, bulk threshold stay 0 (payload is always copied)
+	if(pipe_size) {
+		platform::set_socket_buffer_size(m_connection.write_pipe, pipe_size);
+	}
+}
+
+void socket_transport::close_write()
+{
+	// Other side get EOF, we still read what it send until it close too
+	if(m_connection.write_pipe != invalid_handle) {
+		platform::shutdown_write(m_connection.write_pipe);
+		m_connection.write_pipe = invalid_handle;
+	}
+}
+
+void socket_transport::close_read()
+{
+	if(m_connection.write_pipe == m_connection.read_pipe) {
+		m_connection.write_pipe = invalid_handle;
+	}
+	platform::close_handle(m_connection.read_pipe);
+}
+
+} // end of namespace ipc
+
+#endif // _WIN32
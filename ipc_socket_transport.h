@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ipc_pipe_transport.h"
+
+#ifndef _WIN32
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Unix domain socket transport, one end of socket pair carry both directions.
+// Framing and read buffer are the pipe transport ones, socket differ in closing (our write direction is
+// shut down, handle is closed with read direction) and tuning (socket buffers, no vmsplice).
+class socket_transport : public pipe_transport
+{
+public:
+	socket_transport(client_connection& connection);
+	~socket_transport();
+
+	// Create socket pair (master side), master_end is not inherited, slave_end is inherited by child
+	static bool create_pair(native_handle& master_end, native_handle& slave_end);
+
+	//! \copydoc transport::set_bulk_mode
+	void set_bulk_mode(uint32_t bulk_threshold, uint32_t pipe_size) override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+};
+
+} // end of namespace ipc
+
+#endif // _WIN32
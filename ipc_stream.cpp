@@ -0,0 +1,264 @@
+#include "stdafx.h"
+#include "ipc_stream.h"
+#include <algorithm>
+#include <string.h>
+
+namespace ipc {
+
+#pragma region Writer
+stream_writer::stream_writer(std::weak_ptr<stream_channel> channel, uint32_t id, uint32_t chunk_size, uint32_t window)
+	: m_channel(std::move(channel))
+	, m_id(id)
+	, m_chunk_size(std::max<uint32_t>(chunk_size, 1))
+	, m_max_part_size(std::max<uint32_t>(window / 2, 1))
+	, m_credit(window)
+{
+}
+
+stream_writer::~stream_writer()
+{
+	abort();
+}
+
+bool stream_writer::write(message_view data)
+{
+	return write_chunks(data, m_chunk_size);
+}
+
+bool stream_writer::write_part(message_view data)
+{
+	// Reader keep up to quarter of window for credit batching, bigger part could wait forever
+	if(data.size() > m_max_part_size) {
+		return false;
+	}
+	return write_chunks(data, std::max<size_t>(data.size(), 1));
+}
+
+bool stream_writer::write_chunks(message_view data, size_t max_chunk_size)
+{
+	bool reading_thread = false;
+	if(std::shared_ptr<stream_channel> channel = m_channel.lock()) {
+		reading_thread = channel->is_reading_thread();
+	}
+
+	while(!data.empty()) {
+		size_t chunk_size = std::min<size_t>(data.size(), max_chunk_size);
+		{
+			// Backpressure, reader has window full
+			std::unique_lock<std::mutex> guard(m_lock);
+			if(reading_thread && !m_cancelled && !m_finished && m_credit < chunk_size) {
+				// Credit come through read thread, waiting for it there never end
+				return false;
+			}
+			m_credit_changed.wait(guard, [&]() {
+				return m_cancelled || m_finished || m_credit >= chunk_size;
+			});
+			if(m_cancelled || m_finished) {
+				return false;
+			}
+			m_credit -= chunk_size;
+		}
+
+		std::shared_ptr<stream_channel> channel = m_channel.lock();
+		header header_data;
+		header_data.id = m_id;
+		header_data.flags = HEADER_FLAG_STREAM_DATA;
+		header_data.message_size = static_cast<uint32_t>(chunk_size);
+		if(!channel || !channel->write(header_data, data.first(chunk_size))) {
+			cancel();
+			return false;
+		}
+		data = data.subspan(chunk_size);
+	}
+	return true;
+}
+
+bool stream_writer::close()
+{
+	return finish(HEADER_FLAG_STREAM_END);
+}
+
+void stream_writer::abort()
+{
+	finish(HEADER_FLAG_STREAM_ABORT);
+}
+
+bool stream_writer::finish(uint32_t flags)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if(m_finished) {
+			return false;
+		}
+		m_finished = true;
+		m_credit_changed.notify_all();
+	}
+
+	// Also cancelled stream is ended, so reader side forget it
+	std::shared_ptr<stream_channel> channel = m_channel.lock();
+	header header_data;
+	header_data.id = m_id;
+	header_data.flags = flags;
+	return channel && channel->write(header_data, message_view());
+}
+
+void stream_writer::add_credit(uint32_t bytes)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_credit += bytes;
+	m_credit_changed.notify_all();
+}
+
+void stream_writer::cancel()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_cancelled = true;
+	m_credit_changed.notify_all();
+}
+#pragma endregion Writer
+
+#pragma region Reader
+stream_reader::stream_reader(std::weak_ptr<stream_channel> channel, uint32_t id, uint32_t window, std::vector<uint8_t> metadata, std::shared_ptr<buffer_pool> pool)
+	: m_channel(std::move(channel))
+	, m_id(id)
+	, m_window(window)
+	, m_metadata(std::move(metadata))
+	, m_buffer_pool(std::move(pool))
+{
+}
+
+stream_reader::~stream_reader()
+{
+	cancel();
+	for(std::vector<uint8_t>& chunk : m_chunks) {
+		m_buffer_pool->release(chunk);
+	}
+}
+
+bool stream_reader::read(std::vector<uint8_t>& chunk)
+{
+	size_t chunk_size = 0;
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_chunk_arrived.wait(guard, [&]() {
+			return !m_chunks.empty() || m_finished;
+		});
+		if(m_chunks.empty()) {
+			return false;
+		}
+		// Previous caller buffer is recycled
+		m_buffer_pool->release(chunk);
+		chunk = std::move(m_chunks.front());
+		m_chunks.pop_front();
+		if(m_offset) {
+			// Front chunk was partially read by span read
+			chunk.erase(chunk.begin(), chunk.begin() + m_offset);
+			m_offset = 0;
+		}
+		chunk_size = chunk.size();
+	}
+	consumed(chunk_size);
+	return true;
+}
+
+size_t stream_reader::read(std::span<std::byte> buffer)
+{
+	size_t copied = 0;
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_chunk_arrived.wait(guard, [&]() {
+			return !m_chunks.empty() || m_finished;
+		});
+		while(copied < buffer.size() && !m_chunks.empty()) {
+			std::vector<uint8_t>& front = m_chunks.front();
+			size_t count = std::min(buffer.size() - copied, front.size() - m_offset);
+			::memcpy(buffer.data() + copied, front.data() + m_offset, count);
+			copied += count;
+			m_offset += count;
+			if(m_offset == front.size()) {
+				m_buffer_pool->release(front);
+				m_chunks.pop_front();
+				m_offset = 0;
+			}
+		}
+	}
+	consumed(copied);
+	return copied;
+}
+
+bool stream_reader::succeeded() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_finished && m_success;
+}
+
+void stream_reader::cancel()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		if(m_finished || m_cancelled) {
+			return;
+		}
+		m_cancelled = true;
+	}
+	write_system_message(SYSTEM_MSG_STREAM_CANCEL, 0);
+}
+
+void stream_reader::push(std::vector<uint8_t>& chunk)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	if(m_cancelled) {
+		// Chunk was on the way before writer knew
+		m_buffer_pool->release(chunk);
+		return;
+	}
+	m_chunks.push_back(std::move(chunk));
+	m_chunk_arrived.notify_all();
+}
+
+void stream_reader::finish(bool success)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	if(m_finished) {
+		return;
+	}
+	m_finished = true;
+	m_success = success && !m_cancelled;
+	m_chunk_arrived.notify_all();
+}
+
+void stream_reader::consumed(size_t bytes)
+{
+	uint32_t credit = 0;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_consumed += bytes;
+		// Batch credit, writer chunk is at most half of window, so it never stall on what we keep here
+		if(m_finished || m_consumed < std::max<uint32_t>(m_window / 4, 1)) {
+			return;
+		}
+		credit = static_cast<uint32_t>(m_consumed);
+		m_consumed = 0;
+	}
+	write_system_message(SYSTEM_MSG_STREAM_CREDIT, credit);
+}
+
+void stream_reader::write_system_message(uint32_t type, uint32_t bytes)
+{
+	std::shared_ptr<stream_channel> channel = m_channel.lock();
+	if(!channel) {
+		return;
+	}
+	system_message message_data;
+	message_data.type = type;
+	message_data.messages = m_id;
+	message_data.bytes = bytes;
+
+	header header_data;
+	header_data.flags = HEADER_FLAG_SYSTEM_MSG;
+	header_data.message_size = sizeof(system_message);
+	channel->write(header_data, message_view(reinterpret_cast<const std::byte*>(&message_data), sizeof(system_message)));
+}
+#pragma endregion Reader
+
+} // end of namespace ipc
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+#include "ipc_data.h"
+#include "ipc_buffer_pool.h"
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Path from streams to connection (frames are written by it), closed when connection is released
+// (stream objects can outlive it)
+class stream_channel
+{
+public:
+	using write_fn = std::function<bool(const header& header_data, message_view payload)>;
+	using reading_fn = std::function<bool()>;
+
+	stream_channel(write_fn fn, reading_fn is_reading_fn = nullptr)
+		: m_write_fn(std::move(fn))
+		, m_reading_fn(std::move(is_reading_fn))
+	{}
+
+	bool write(const header& header_data, message_view payload) {
+		std::shared_lock<std::shared_mutex> guard(m_lock);
+		return m_write_fn ? m_write_fn(header_data, payload) : false;
+	}
+
+	// Caller is the thread which receive credit of connection (it must never wait for it)
+	bool is_reading_thread() {
+		std::shared_lock<std::shared_mutex> guard(m_lock);
+		return m_reading_fn ? m_reading_fn() : false;
+	}
+
+	// Wait for running writes, no write after this
+	void close() {
+		std::unique_lock<std::shared_mutex> guard(m_lock);
+		m_write_fn = nullptr;
+		m_reading_fn = nullptr;
+	}
+
+private:
+	std::shared_mutex m_lock;
+	write_fn m_write_fn;
+	reading_fn m_reading_fn;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Sending end of stream. Data is split into chunk frames, writer wait while reader has window full
+// (not consumed chunks), so memory of both sides stay bounded whatever stream length is.
+class stream_writer
+{
+public:
+	stream_writer(std::weak_ptr<stream_channel> channel, uint32_t id, uint32_t chunk_size, uint32_t window);
+	// Stream which was not closed is aborted (reader see failed end)
+	~stream_writer();
+
+	stream_writer(const stream_writer&) = delete;
+	stream_writer& operator=(const stream_writer&) = delete;
+
+	uint32_t id() const {
+		return m_id;
+	}
+
+	// Write data (block while reader has no room for it), false when reader cancelled stream or communication ended.
+	// Read thread of connection does not wait (credit come through it), it get false when reader has no room.
+	bool write(message_view data);
+	bool write(const std::vector<uint8_t>& data) {
+		return write(to_view(data));
+	}
+	// Write data as one chunk, reader get it by one read(vector&) (it must fit into half of reader window)
+	bool write_part(message_view data);
+	bool write_part(const std::vector<uint8_t>& data) {
+		return write_part(to_view(data));
+	}
+	// Biggest part write_part accept
+	uint32_t max_part_size() const {
+		return m_max_part_size;
+	}
+	// End of stream, reader get it after all data
+	bool close();
+	// Failed end of stream
+	void abort();
+
+	// Connection side, reader consumed bytes
+	void add_credit(uint32_t bytes);
+	// Connection side, reader does not want more data (or communication ended)
+	void cancel();
+
+private:
+	bool write_chunks(message_view data, size_t max_chunk_size);
+	bool finish(uint32_t flags);
+
+private:
+	std::weak_ptr<stream_channel> m_channel;
+	uint32_t m_id = 0;
+	uint32_t m_chunk_size = 0;
+	uint32_t m_max_part_size = 0;
+
+	std::mutex m_lock;
+	std::condition_variable m_credit_changed;
+	uint64_t m_credit = 0;      // Bytes we can write before reader consume some
+	bool m_cancelled = false;
+	bool m_finished = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Receiving end of stream, chunks are queued by read thread until they are read
+class stream_reader
+{
+public:
+	stream_reader(std::weak_ptr<stream_channel> channel, uint32_t id, uint32_t window, std::vector<uint8_t> metadata, std::shared_ptr<buffer_pool> pool);
+	// Stream which was not read to its end is cancelled (writer stop)
+	~stream_reader();
+
+	stream_reader(const stream_reader&) = delete;
+	stream_reader& operator=(const stream_reader&) = delete;
+
+	uint32_t id() const {
+		return m_id;
+	}
+	// Message given by writer when it opened stream
+	const std::vector<uint8_t>& metadata() const {
+		return m_metadata;
+	}
+
+	// Next chunk (block until it arrive), chunk buffer is swapped, false at end of stream
+	bool read(std::vector<uint8_t>& chunk);
+	// Copy next bytes into buffer (block until some arrive), return number of bytes, 0 at end of stream
+	size_t read(std::span<std::byte> buffer);
+	// Input iterator over chunks (partial responses), `for(const std::vector<uint8_t>& part : *reader)`
+	class iterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::vector<uint8_t>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		iterator() = default;
+		explicit iterator(stream_reader* reader)
+			: m_reader(reader)
+		{
+			++*this;
+		}
+
+		reference operator*() const {
+			return m_chunk;
+		}
+		pointer operator->() const {
+			return &m_chunk;
+		}
+		iterator& operator++() {
+			if(m_reader && !m_reader->read(m_chunk)) {
+				m_reader = nullptr;
+			}
+			return *this;
+		}
+		bool operator==(const iterator& other) const {
+			return m_reader == other.m_reader;
+		}
+
+	private:
+		stream_reader* m_reader = nullptr;  // nullptr at end
+		std::vector<uint8_t> m_chunk;
+	};
+	iterator begin() {
+		return iterator(this);
+	}
+	iterator end() {
+		return iterator();
+	}
+
+	// Stream ended by writer close (not aborted, cancelled or disconnected), valid after read reported end
+	bool succeeded() const;
+	// Tell writer we do not want more data
+	void cancel();
+
+	// Connection side (read thread), chunk is moved in
+	void push(std::vector<uint8_t>& chunk);
+	// Connection side, end of stream
+	void finish(bool success);
+
+private:
+	// Give credit back to writer (batched)
+	void consumed(size_t bytes);
+	void write_system_message(uint32_t type, uint32_t bytes);
+
+private:
+	std::weak_ptr<stream_channel> m_channel;
+	uint32_t m_id = 0;
+	uint32_t m_window = 0;
+	std::vector<uint8_t> m_metadata;
+	std::shared_ptr<buffer_pool> m_buffer_pool;  // Chunks go back there
+
+	mutable std::mutex m_lock;
+	std::condition_variable m_chunk_arrived;
+	std::deque<std::vector<uint8_t>> m_chunks;
+	size_t m_offset = 0;         // Read position in front chunk (span read)
+	uint64_t m_consumed = 0;     // Consumed bytes not given back yet
+	bool m_finished = false;
+	bool m_success = false;
+	bool m_cancelled = false;
+};
+
+} // end of namespace ipc
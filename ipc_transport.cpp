@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "ipc_transport.h"
+#include "ipc_pipe_transport.h"
+#include "ipc_shm_transport.h"
+#include "ipc_socket_transport.h"
+#include "ipc_seqpacket_transport.h"
+#include "ipc_loopback_transport.h"
+#include "ipc_uring_transport.h"
+
+namespace ipc {
+
+std::unique_ptr<transport> transport::factory::create_transport(client_connection& connection, bool master_side) const
+{
+	if(connection.loopback) {
+		return std::make_unique<loopback_transport>(connection, master_side);
+	}
+#ifdef __linux__
+	if(connection.shared_memory != invalid_handle) {
+		return std::make_unique<shm_transport>(connection, master_side);
+	}
+	// Slave get the same /sock= parameter for both socket kinds, socket itself tell which one it is
+	if(connection.socket != invalid_handle && seqpacket_transport::is_packet_socket(connection.socket)) {
+		return std::make_unique<seqpacket_transport>(connection);
+	}
+	if(connection.io_uring && connection.read_pipe != invalid_handle) {
+		if(std::unique_ptr<uring_transport> uring = uring_transport::create(connection)) {
+			return uring;
+		}
+		// io_uring is not available (old kernel, io_uring_disabled sysctl, seccomp), the same pipes by plain I/O
+	}
+#endif
+#ifndef _WIN32
+	if(connection.socket != invalid_handle) {
+		return std::make_unique<socket_transport>(connection);
+	}
+#endif
+	return std::make_unique<pipe_transport>(connection);
+}
+
+} // end of namespace ipc
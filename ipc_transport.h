@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "ipc_data.h"
+#include "ipc_buffer_pool.h"
+
+namespace ipc {
+
+enum class transport_type {
+	pipe,           // Anonymous pipes
+	shared_memory,  // Shared memory ring buffers (Linux only, otherwise pipe is used)
+	socket,         // Unix domain socket pair (POSIX only, otherwise pipe is used)
+	seqpacket,      // Unix domain SOCK_SEQPACKET socket pair, frame is datagram (Linux only, otherwise pipe is used)
+	loopback,       // In-process queues, slave is created by master_intf::take_slave_connection() in same process
+	io_uring,       // Pipes driven by io_uring on both sides (Linux, plain pipe I/O when io_uring is not available)
+};
+
+// Transport of master created without explicit type, build select it by IPC_DEFAULT_TRANSPORT
+// (pipe, shared_memory, socket, seqpacket, loopback, io_uring), run-time selection is master constructor argument
+#ifndef IPC_DEFAULT_TRANSPORT
+#define IPC_DEFAULT_TRANSPORT pipe
+#endif
+constexpr transport_type default_transport = transport_type::IPC_DEFAULT_TRANSPORT;
+
+//////////////////////////////////////////////////////////////////////////
+// What event loop (reactor) can do with next frame, see transport::poll_frame
+enum class frame_state {
+	complete,    // Whole frame is in transport buffer, it is read without waiting
+	partial,     // It is not there whole yet, rest of it make read handle readable again
+	unbuffered,  // Read may wait (frame does not fit into buffer, transport can not tell, read fail)
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Transport carrying frames (ipc::header + payload) between master and slave.
+// write_frame is serialized by caller (common::m_write_lock), read_frame is called only from read thread.
+class transport
+{
+public:
+	virtual ~transport() = default;
+
+	struct factory {
+		// Create transport for connection (take ownership of its handles)
+		virtual std::unique_ptr<transport> create_transport(client_connection& connection, bool master_side) const;
+	};
+
+	// Write whole frame (header + payload gathered from parts, parts are not copied into one buffer first)
+	virtual platform::io_result write_frame(const header& header_data, message_parts parts) = 0;
+	// Write whole frame (header + payload)
+	platform::io_result write_frame(const header& header_data, const void* data, size_t size) {
+		message_view part(static_cast<const std::byte*>(data), size);
+		return write_frame(header_data, message_parts(&part, 1));
+	}
+	// Write whole frame whose payload memory stays unchanged until other side read it (sender wait for response),
+	// so transport can pass it by reference instead of copying it
+	virtual platform::io_result write_frame_stable(const header& header_data, message_parts parts) {
+		return write_frame(header_data, parts);
+	}
+	// Read whole frame, payload is resized to header_data.message_size (its memory is taken from buffer pool when too small)
+	virtual platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) = 0;
+
+	// Read whole frame, payload points into transport receive buffer (shared memory ring, pipe read buffer)
+	// when frame is there in one piece, otherwise into transport owned buffer.
+	// It is valid until release_frame() or next read.
+	virtual platform::io_result read_frame_view(header& header_data, message_view& payload) {
+		platform::io_result result = read_frame(header_data, m_view_buffer);
+		payload = to_view(m_view_buffer);
+		return result;
+	}
+	// Payload of read_frame_view is not used anymore
+	virtual void release_frame() {
+		if(m_buffer_pool && !m_view_buffer.empty()) {
+			m_buffer_pool->release(m_view_buffer);
+		}
+	}
+
+	// Frames with bigger payload are refused (read_frame fail), nothing is allocated for them
+	void set_max_message_size(uint32_t max_message_size) {
+		m_max_message_size = max_message_size;
+	}
+
+	// Payload buffers of read_frame are taken from this pool
+	void set_buffer_pool(std::shared_ptr<buffer_pool> pool) {
+		m_buffer_pool = std::move(pool);
+	}
+	// Pool both sides should use, as written buffers are moved to other side (in-process transport), nullptr otherwise
+	virtual std::shared_ptr<buffer_pool> shared_buffer_pool() const {
+		return nullptr;
+	}
+
+	// Bulk transfer tuning, stable payloads of bulk_threshold bytes and bigger are passed by reference (0 = never),
+	// pipe buffer is resized to pipe_size (0 = system default)
+	virtual void set_bulk_mode(uint32_t, uint32_t) {}
+
+	// Close our write direction (other side read_frame ends with io_result::disconnected)
+	virtual void close_write() = 0;
+	// Close our read direction (when read thread finished)
+	virtual void close_read() = 0;
+	// Abort read_frame waiting for data (it return io_result::disconnected, also every next one), called from other
+	// thread, so read thread can be joined even when other side does not close its write direction
+	virtual void wakeup() = 0;
+
+	// Handle which become readable when frame data arrive, so event loop (reactor) can wait for it instead of
+	// read thread (invalid_handle when transport can not be waited for this way)
+	virtual native_handle read_handle() const {
+		return invalid_handle;
+	}
+	// Take what arrived on read handle into transport buffer without waiting and tell whether next frame can be
+	// read without waiting (its header is copied into header_data then)
+	virtual frame_state poll_frame(header&) {
+		return frame_state::unbuffered;
+	}
+
+protected:
+	// Empty payload with capacity for size bytes
+	void prepare_payload(std::vector<uint8_t>& payload, size_t size) {
+		payload.clear();
+		if(payload.capacity() < size && m_buffer_pool) {
+			m_buffer_pool->release(payload);
+			payload = m_buffer_pool->acquire(size);
+		}
+	}
+
+protected:
+	uint32_t m_max_message_size = UINT32_MAX;
+	std::shared_ptr<buffer_pool> m_buffer_pool;
+	std::vector<uint8_t> m_view_buffer;  // Payload of read_frame_view which is not in receive buffer
+};
+
+} // end of namespace ipc
@@ -0,0 +1,612 @@
+#include "stdafx.h"
+#include "ipc_uring_transport.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <atomic>
+
+namespace ipc {
+
+// IORING_OP_READ_MULTISHOT (Linux 6.7), older kernel headers do not have it yet
+constexpr uint8_t op_read_multishot = 49;
+constexpr uint16_t buffer_group = 0;
+
+// Completion tags
+constexpr uint64_t tag_read = 1;
+constexpr uint64_t tag_write = 2;
+constexpr uint64_t tag_wakeup = 3;
+constexpr uint64_t tag_cancel = 4;
+constexpr uint64_t tag_provide = 5;
+constexpr uint64_t tag_timeout = 6;
+
+template<typename T>
+static T load_acquire(T* value)
+{
+	return std::atomic_ref<T>(*value).load(std::memory_order_acquire);
+}
+
+template<typename T>
+static void store_release(T* value, T new_value)
+{
+	std::atomic_ref<T>(*value).store(new_value, std::memory_order_release);
+}
+
+std::unique_ptr<uring_transport> uring_transport::create(client_connection& connection)
+{
+	std::unique_ptr<uring_transport> transport(new uring_transport());
+	if(!transport->initialize()) {
+		return nullptr;
+	}
+	// We own pipes now
+	transport->m_connection.read_pipe = connection.read_pipe;
+	transport->m_connection.write_pipe = connection.write_pipe;
+	connection.read_pipe = invalid_handle;
+	connection.write_pipe = invalid_handle;
+	return transport;
+}
+
+uring_transport::~uring_transport()
+{
+	if(m_ready) {
+		close_write();
+		close_read();
+	}
+	platform::close_handle(m_connection.write_pipe);
+	platform::close_handle(m_connection.read_pipe);
+
+	// Kernel does not touch buffers after ring is closed and unmapped
+	if(m_ring >= 0) {
+		::close(m_ring);
+	}
+	if(m_sqes) {
+		::munmap(m_sqes, m_sqes_size);
+	}
+	if(m_cq_mapping && m_cq_mapping != m_sq_mapping) {
+		::munmap(m_cq_mapping, m_cq_mapping_size);
+	}
+	if(m_sq_mapping) {
+		::munmap(m_sq_mapping, m_sq_mapping_size);
+	}
+}
+
+bool uring_transport::initialize()
+{
+	//////////////////////////////////////////////////////////////////////////
+	// Ring (raw syscalls, no liburing dependency), it fail with ENOSYS/EPERM when io_uring is disabled
+	io_uring_params params = {};
+	m_ring = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &params));
+	if(m_ring < 0) {
+		m_ring = -1;
+		return false;
+	}
+
+	m_sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	m_cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if(single_mapping) {
+		m_sq_mapping_size = m_cq_mapping_size = std::max(m_sq_mapping_size, m_cq_mapping_size);
+	}
+	m_sq_mapping = ::mmap(nullptr, m_sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+	if(m_sq_mapping == MAP_FAILED) {
+		m_sq_mapping = nullptr;
+		return false;
+	}
+	m_cq_mapping = single_mapping ? m_sq_mapping : ::mmap(nullptr, m_cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+	if(m_cq_mapping == MAP_FAILED) {
+		m_cq_mapping = nullptr;
+		return false;
+	}
+	m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+	if(sqes == MAP_FAILED) {
+		return false;
+	}
+	m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+	uint8_t* sq = static_cast<uint8_t*>(m_sq_mapping);
+	uint8_t* cq = static_cast<uint8_t*>(m_cq_mapping);
+	m_sq_head = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+	m_sq_tail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+	m_sq_mask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+	m_sq_entries = params.sq_entries;
+	m_sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+	m_cq_head = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+	m_cq_tail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+	m_cq_mask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	m_multishot = op_supported(op_read_multishot);
+
+	m_skip_success = (params.features & IORING_FEAT_CQE_SKIP) != 0;
+
+	//////////////////////////////////////////////////////////////////////////
+	// Provided buffers (kernel pick buffer when data arrive, so armed read does not pin any).
+	// IORING_OP_PROVIDE_BUFFERS rather than registered buffer ring, kernels which have the latter do not all
+	// fill reads from it (ENOBUFS with buffers there), the former work everywhere since Linux 5.7
+	m_buffers.reset(new uint8_t[buffer_count * buffer_size]);
+	if(!push(provide_entry(0, buffer_count)) || enter(m_sq_pending, 1, IORING_ENTER_GETEVENTS) < 0) {
+		return false;
+	}
+	m_sq_pending = 0;
+	uint32_t head = *m_cq_head;
+	int32_t provided = m_cqes[head & m_cq_mask].res;
+	store_release(m_cq_head, head + 1);
+	if(provided < 0) {
+		return false;
+	}
+
+	m_send_ring.reset(new uint8_t[send_ring_size]);
+	m_ready = true;
+	return true;
+}
+
+bool uring_transport::op_supported(uint8_t op)
+{
+	constexpr size_t max_ops = 256;
+	alignas(io_uring_probe) uint8_t storage[sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op)] = {};
+	io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage);
+	if(::syscall(__NR_io_uring_register, m_ring, IORING_REGISTER_PROBE, probe, max_ops) != 0) {
+		return false;
+	}
+	return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+}
+
+#pragma region Ring
+int uring_transport::enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+	while(true) {
+		int result = static_cast<int>(::syscall(__NR_io_uring_enter, m_ring, to_submit, min_complete, flags, nullptr, 0));
+		if(result < 0 && errno == EINTR) continue;
+		return result;
+	}
+}
+
+bool uring_transport::push(const io_uring_sqe& entry)
+{
+	uint32_t tail = *m_sq_tail;
+	while(tail - load_acquire(m_sq_head) >= m_sq_entries) {
+		// Queue is full (recycled buffers wait for next enter), kernel consume it on submit
+		if(enter(m_sq_pending, 0, 0) >= 0) {
+			m_sq_pending = 0;
+		} else if(errno == EBUSY) {
+			reap();
+		} else {
+			return false;
+		}
+	}
+	uint32_t index = tail & m_sq_mask;
+	m_sqes[index] = entry;
+	m_sq_array[index] = index;
+	store_release(m_sq_tail, tail + 1);
+	m_sq_pending++;
+	return true;
+}
+
+bool uring_transport::submit(const io_uring_sqe& entry)
+{
+	if(!push(entry)) {
+		return false;
+	}
+	while(enter(m_sq_pending, 0, 0) < 0) {
+		if(errno != EBUSY) {
+			return false;
+		}
+		// Completion queue is full, make room
+		reap();
+	}
+	m_sq_pending = 0;
+	return true;
+}
+
+void uring_transport::reap()
+{
+	uint32_t head = *m_cq_head;
+	uint32_t tail = load_acquire(m_cq_tail);
+	bool written = false;
+	for(; head != tail; head++) {
+		const io_uring_cqe& completion = m_cqes[head & m_cq_mask];
+		if(completion.user_data == tag_read) {
+			on_read(completion);
+		} else if(completion.user_data == tag_write) {
+			on_write(completion.res);
+			written = true;
+		} else if(completion.user_data == tag_timeout) {
+			m_drain_expired = true;
+			m_progress.notify_all();
+		}
+		// tag_wakeup and tag_cancel only wake up waiting thread, tag_provide fail only when buffer is given twice
+	}
+	store_release(m_cq_head, head);
+
+	if(written) {
+		// What was appended meanwhile go by one write
+		submit_send();
+		m_progress.notify_all();
+	}
+}
+
+void uring_transport::on_read(const io_uring_cqe& completion)
+{
+	if(!(completion.flags & IORING_CQE_F_MORE)) {
+		m_read_armed = false;
+	}
+	uint16_t buffer_id = static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT);
+	if(completion.res > 0) {
+		completed_read& read = m_reads[(m_reads_begin + m_reads_count) % buffer_count];
+		read.buffer_id = buffer_id;
+		read.size = static_cast<uint32_t>(completion.res);
+		m_reads_count++;
+		return;
+	}
+	if(completion.flags & IORING_CQE_F_BUFFER) {
+		recycle(buffer_id);
+	}
+	if(completion.res == 0) {
+		m_read_result = platform::io_result::disconnected; // EOF, all write ends closed
+	} else if(completion.res != -ENOBUFS && completion.res != -ECANCELED) {
+		// ENOBUFS all buffers wait for parsing, read is armed again when read thread give them back
+		m_read_result = (completion.res == -EBADF) ? platform::io_result::disconnected : platform::io_result::failed;
+	}
+}
+
+void uring_transport::on_write(int32_t result)
+{
+	if(result < 0 && result != -EAGAIN && result != -EINTR) {
+		m_write_result = (result == -EPIPE || result == -EBADF) ? platform::io_result::disconnected : platform::io_result::failed;
+	} else if(result > 0) {
+		m_send_tail += static_cast<uint64_t>(result);
+	}
+	// Short write, rest is submitted again
+	m_send_submitted = m_send_tail;
+}
+
+template<typename Predicate>
+void uring_transport::wait_until(std::unique_lock<std::mutex>& guard, Predicate predicate)
+{
+	bool running = wait_completions(guard, [&]() {
+		return predicate() || m_write_result != platform::io_result::ok;
+	});
+	if(!running) {
+		m_write_result = platform::io_result::failed;
+	}
+}
+
+template<typename Predicate>
+bool uring_transport::wait_completions(std::unique_lock<std::mutex>& guard, Predicate predicate)
+{
+	while(!predicate()) {
+		if(m_reader_waiting) {
+			// Read thread collect completions, it notify us
+			m_progress.wait(guard);
+		} else if(enter(m_sq_pending, 1, IORING_ENTER_GETEVENTS) >= 0 || errno == ETIME) {
+			// Read thread is busy (or finished), collect them ourselves
+			m_sq_pending = 0;
+			reap();
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+#pragma endregion Ring
+
+#pragma region Write
+platform::io_result uring_transport::write_frame(const header& header_data, message_parts parts)
+{
+	size_t frame_size = sizeof(ipc::header) + header_data.message_size;
+	std::unique_lock<std::mutex> guard(m_ring_lock);
+	if(frame_size > direct_write_size) {
+		// Copy into send ring cost more than write syscall, write it after queued frames from caller memory
+		wait_until(guard, [&]() {
+			return m_send_tail == m_send_head;
+		});
+		if(m_write_result != platform::io_result::ok) {
+			return m_write_result;
+		}
+		guard.unlock();
+		return write_direct(header_data, parts);
+	}
+
+	wait_until(guard, [&]() {
+		return send_ring_size - (m_send_head - m_send_tail) >= frame_size;
+	});
+	if(m_write_result != platform::io_result::ok) {
+		return m_write_result;
+	}
+	append(&header_data, sizeof(ipc::header));
+	for(const message_view& part : parts) {
+		append(part.data(), part.size());
+	}
+	submit_send();
+	return m_write_result;
+}
+
+void uring_transport::append(const void* data, size_t size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	while(size > 0) {
+		size_t offset = static_cast<size_t>(m_send_head & (send_ring_size - 1));
+		size_t count = std::min(size, send_ring_size - offset);
+		::memcpy(m_send_ring.get() + offset, src, count);
+		m_send_head += count;
+		src += count;
+		size -= count;
+	}
+}
+
+void uring_transport::submit_send()
+{
+	// One write in flight, the rest wait for its completion
+	if(m_send_submitted != m_send_tail || m_send_head == m_send_tail || m_write_result != platform::io_result::ok) {
+		return;
+	}
+	size_t offset = static_cast<size_t>(m_send_tail & (send_ring_size - 1));
+	size_t size = static_cast<size_t>(std::min<uint64_t>(m_send_head - m_send_tail, send_ring_size - offset));
+
+	io_uring_sqe entry = {};
+	entry.opcode = IORING_OP_WRITE;
+	entry.fd = m_connection.write_pipe;
+	entry.addr = reinterpret_cast<uint64_t>(m_send_ring.get() + offset);
+	entry.len = static_cast<uint32_t>(size);
+	entry.user_data = tag_write;
+	if(!submit(entry)) {
+		m_write_result = platform::io_result::failed;
+		return;
+	}
+	m_send_submitted = m_send_tail + size;
+}
+
+platform::io_result uring_transport::write_direct(const header& header_data, message_parts parts)
+{
+	// Same gathered write as pipe transport, we are the only writer now (send ring is empty)
+	constexpr size_t max_buffers = 16;
+	platform::io_buffer buffers[max_buffers];
+	buffers[0].data = &header_data;
+	buffers[0].size = sizeof(ipc::header);
+	size_t count = 1;
+	for(const message_view& part : parts) {
+		if(count == max_buffers) {
+			platform::io_result result = platform::write_all(m_connection.write_pipe, buffers, count);
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+			count = 0;
+		}
+		buffers[count].data = part.data();
+		buffers[count].size = part.size();
+		count++;
+	}
+	return platform::write_all(m_connection.write_pipe, buffers, count);
+}
+
+void uring_transport::set_bulk_mode(uint32_t, uint32_t pipe_size)
+{
+	if(pipe_size) {
+		platform::set_pipe_size(m_connection.write_pipe, pipe_size);
+		platform::set_pipe_size(m_connection.read_pipe, pipe_size);
+	}
+}
+
+void uring_transport::close_write()
+{
+	std::unique_lock<std::mutex> guard(m_ring_lock);
+	if(m_send_tail != m_send_head && m_write_result == platform::io_result::ok) {
+		// Queued frames go out first, but other side may not read anymore (timeout completion end the wait)
+		__kernel_timespec period = {};
+		period.tv_sec = drain_timeout_ms / 1000;
+		period.tv_nsec = static_cast<long long>(drain_timeout_ms % 1000) * 1000000;
+		io_uring_sqe entry = {};
+		entry.opcode = IORING_OP_TIMEOUT;
+		entry.addr = reinterpret_cast<uint64_t>(&period);   // Copied on submit
+		entry.len = 1;
+		entry.user_data = tag_timeout;
+		m_drain_expired = false;
+		if(submit(entry)) {
+			wait_until(guard, [&]() {
+				return m_send_tail == m_send_head || m_drain_expired;
+			});
+		}
+	}
+
+	if(m_send_submitted != m_send_tail) {
+		// Write still in flight, it is cancelled (and not submitted again) before pipe and send ring are gone
+		if(m_write_result == platform::io_result::ok) {
+			m_write_result = platform::io_result::disconnected;
+		}
+		io_uring_sqe entry = {};
+		entry.opcode = IORING_OP_ASYNC_CANCEL;
+		entry.addr = tag_write;
+		entry.user_data = tag_cancel;
+		if(submit(entry)) {
+			wait_completions(guard, [&]() {
+				return m_send_submitted == m_send_tail;
+			});
+		}
+	}
+	platform::close_handle(m_connection.write_pipe);
+}
+#pragma endregion Write
+
+#pragma region Read
+platform::io_result uring_transport::read_frame(header& header_data, std::vector<uint8_t>& payload)
+{
+	platform::io_result result = read_bytes(&header_data, sizeof(ipc::header));
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	if(header_data.message_size > m_max_message_size) {
+		return platform::io_result::failed;
+	}
+	prepare_payload(payload, header_data.message_size);
+	payload.resize(header_data.message_size);
+	return read_bytes(payload.data(), payload.size());
+}
+
+platform::io_result uring_transport::read_frame_view(header& header_data, message_view& payload)
+{
+	platform::io_result result = read_bytes(&header_data, sizeof(ipc::header));
+	if(result != platform::io_result::ok) {
+		return result;
+	}
+	if(header_data.message_size > m_max_message_size) {
+		return platform::io_result::failed;
+	}
+	if(header_data.message_size && m_current >= 0 && current_available() == 0) {
+		result = next_buffer();
+		if(result != platform::io_result::ok) {
+			return result;
+		}
+	}
+	if(header_data.message_size == 0 || (m_current >= 0 && current_available() >= header_data.message_size)) {
+		// Whole payload in provided buffer, it is given back to kernel when we move to next one
+		payload = message_view(reinterpret_cast<const std::byte*>(m_current >= 0 ? current_data() : nullptr), header_data.message_size);
+		m_current_offset += header_data.message_size;
+		return platform::io_result::ok;
+	}
+
+	prepare_payload(m_view_buffer, header_data.message_size);
+	m_view_buffer.resize(header_data.message_size);
+	payload = to_view(m_view_buffer);
+	return read_bytes(m_view_buffer.data(), m_view_buffer.size());
+}
+
+platform::io_result uring_transport::read_bytes(void* data, size_t size)
+{
+	uint8_t* dst = static_cast<uint8_t*>(data);
+	while(size > 0) {
+		if(m_current < 0 || current_available() == 0) {
+			platform::io_result result = next_buffer();
+			if(result != platform::io_result::ok) {
+				return result;
+			}
+		}
+		size_t count = std::min(size, current_available());
+		::memcpy(dst, current_data(), count);
+		m_current_offset += count;
+		dst += count;
+		size -= count;
+	}
+	return platform::io_result::ok;
+}
+
+platform::io_result uring_transport::next_buffer()
+{
+	std::unique_lock<std::mutex> guard(m_ring_lock);
+	if(m_current >= 0) {
+		recycle(static_cast<uint16_t>(m_current));
+		m_current = -1;
+	}
+
+	while(m_reads_count == 0) {
+		if(m_woken) {
+			return platform::io_result::disconnected;
+		}
+		if(m_read_result != platform::io_result::ok) {
+			return m_read_result;
+		}
+		if(!m_read_armed && !arm_read()) {
+			return platform::io_result::failed;
+		}
+		// Sleep outside of lock, writers submit meanwhile (and leave completions to us).
+		// Given back buffers go to kernel by the same call.
+		uint32_t to_submit = m_sq_pending;
+		m_sq_pending = 0;
+		m_reader_waiting = true;
+		guard.unlock();
+		enter(to_submit, 1, IORING_ENTER_GETEVENTS);
+		guard.lock();
+		m_reader_waiting = false;
+		reap();
+		// Writers waiting for us collect completions themselves until we sleep again
+		m_progress.notify_all();
+	}
+
+	const completed_read& read = m_reads[m_reads_begin];
+	m_current = read.buffer_id;
+	m_current_size = read.size;
+	m_current_offset = 0;
+	m_reads_begin = (m_reads_begin + 1) % buffer_count;
+	m_reads_count--;
+	return platform::io_result::ok;
+}
+
+bool uring_transport::arm_read()
+{
+	// Multishot read stay armed (one completion per filled buffer), single read is armed for every buffer
+	io_uring_sqe entry = {};
+	entry.opcode = m_multishot ? static_cast<uint8_t>(op_read_multishot) : static_cast<uint8_t>(IORING_OP_READ);
+	entry.fd = m_connection.read_pipe;
+	entry.flags = IOSQE_BUFFER_SELECT;
+	entry.buf_group = buffer_group;
+	entry.len = m_multishot ? 0 : static_cast<uint32_t>(buffer_size);
+	entry.off = static_cast<uint64_t>(-1);
+	entry.user_data = tag_read;
+	m_read_armed = submit(entry);
+	return m_read_armed;
+}
+
+io_uring_sqe uring_transport::provide_entry(uint16_t first_id, uint16_t count)
+{
+	io_uring_sqe entry = {};
+	entry.opcode = IORING_OP_PROVIDE_BUFFERS;
+	entry.fd = count;
+	entry.addr = reinterpret_cast<uint64_t>(m_buffers.get() + static_cast<size_t>(first_id) * buffer_size);
+	entry.len = static_cast<uint32_t>(buffer_size);
+	entry.off = first_id;
+	entry.buf_group = buffer_group;
+	entry.user_data = tag_provide;
+	return entry;
+}
+
+void uring_transport::recycle(uint16_t buffer_id)
+{
+	// Queued only, it is submitted by next io_uring_enter (no syscall of its own)
+	io_uring_sqe entry = provide_entry(buffer_id, 1);
+	if(m_skip_success) {
+		entry.flags = IOSQE_CQE_SKIP_SUCCESS;
+	}
+	if(!push(entry)) {
+		m_read_result = platform::io_result::failed;
+	}
+}
+
+void uring_transport::close_read()
+{
+	std::unique_lock<std::mutex> guard(m_ring_lock);
+	if(m_read_armed) {
+		// Armed read must end before buffers are freed
+		io_uring_sqe entry = {};
+		entry.opcode = IORING_OP_ASYNC_CANCEL;
+		entry.addr = tag_read;
+		entry.user_data = tag_cancel;
+		if(submit(entry)) {
+			while(m_read_armed && enter(m_sq_pending, 1, IORING_ENTER_GETEVENTS) >= 0) {
+				m_sq_pending = 0;
+				reap();
+			}
+		}
+	}
+	platform::close_handle(m_connection.read_pipe);
+}
+
+void uring_transport::wakeup()
+{
+	std::lock_guard<std::mutex> guard(m_ring_lock);
+	m_woken = true;
+	// Completion wake up read thread sleeping in io_uring_enter
+	io_uring_sqe entry = {};
+	entry.opcode = IORING_OP_NOP;
+	entry.user_data = tag_wakeup;
+	submit(entry);
+}
+#pragma endregion Read
+
+} // end of namespace ipc
+
+#endif // __linux__
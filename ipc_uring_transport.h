@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ipc_transport.h"
+
+#ifdef __linux__
+
+#include <condition_variable>
+#include <mutex>
+#include <linux/io_uring.h>
+
+namespace ipc {
+
+//////////////////////////////////////////////////////////////////////////
+// Pipe transport driven by io_uring. Read side keep one multishot read armed on read pipe, kernel fill
+// provided buffers and read thread only collect completions (one io_uring_enter bring all reads completed
+// meanwhile, no read syscall per frame). Write side copy frames into send ring, frames written while previous
+// write is in flight are submitted together by one write when it completes (no syscall for them).
+// Wire is the same as of pipe transport, so each side can use it or not on its own.
+class uring_transport : public transport
+{
+public:
+	static constexpr uint32_t ring_entries = 64;
+	static constexpr uint32_t buffer_count = 16;              // Provided read buffers (power of two)
+	static constexpr size_t buffer_size = 64 * 1024;
+	static constexpr size_t send_ring_size = 1024 * 1024;     // Must be power of two
+	static constexpr size_t direct_write_size = 256 * 1024;   // Bigger frames are written from caller memory
+	static constexpr uint32_t drain_timeout_ms = 1000;        // close_write wait for queued frames at most (other side may not read)
+
+	// Take pipes of connection, nullptr when io_uring (Linux 5.7) is not available
+	// (connection is not changed then, caller use pipe transport)
+	static std::unique_ptr<uring_transport> create(client_connection& connection);
+	~uring_transport();
+
+	//! \copydoc transport::write_frame
+	platform::io_result write_frame(const header& header_data, message_parts parts) override;
+	using transport::write_frame;
+	//! \copydoc transport::read_frame
+	platform::io_result read_frame(header& header_data, std::vector<uint8_t>& payload) override;
+	//! \copydoc transport::read_frame_view
+	platform::io_result read_frame_view(header& header_data, message_view& payload) override;
+	//! \copydoc transport::set_bulk_mode
+	void set_bulk_mode(uint32_t bulk_threshold, uint32_t pipe_size) override;
+	//! \copydoc transport::close_write
+	void close_write() override;
+	//! \copydoc transport::close_read
+	void close_read() override;
+	//! \copydoc transport::wakeup
+	void wakeup() override;
+
+private:
+	uring_transport() = default;
+	bool initialize();
+
+	// Ring (m_ring_lock must be held)
+	int enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+	// Queue entry (submitted by next enter), queued entries are submitted first when queue is full
+	bool push(const io_uring_sqe& entry);
+	// Queue entry and submit it with all queued before
+	bool submit(const io_uring_sqe& entry);
+	void reap();
+	void on_read(const io_uring_cqe& completion);
+	void on_write(int32_t result);
+	bool op_supported(uint8_t op);
+	// Wait until predicate or write failure, completions are collected by read thread when it sleeps for them,
+	// otherwise by us
+	template<typename Predicate>
+	void wait_until(std::unique_lock<std::mutex>& guard, Predicate predicate);
+	// Wait until predicate whatever write result is (false when ring failed)
+	template<typename Predicate>
+	bool wait_completions(std::unique_lock<std::mutex>& guard, Predicate predicate);
+
+	// Write side (m_ring_lock must be held)
+	void append(const void* data, size_t size);
+	void submit_send();
+	platform::io_result write_direct(const header& header_data, message_parts parts);
+
+	// Read side (read thread)
+	bool arm_read();
+	io_uring_sqe provide_entry(uint16_t first_id, uint16_t count);
+	void recycle(uint16_t buffer_id);
+	platform::io_result next_buffer();
+	platform::io_result read_bytes(void* data, size_t size);
+	size_t current_available() const {
+		return m_current_size - m_current_offset;
+	}
+	const uint8_t* current_data() const {
+		return m_buffers.get() + static_cast<size_t>(m_current) * buffer_size + m_current_offset;
+	}
+
+private:
+	struct completed_read {
+		uint16_t buffer_id = 0;
+		uint32_t size = 0;
+	};
+
+	client_connection m_connection;
+	bool m_ready = false;
+
+	// Ring mappings
+	int m_ring = -1;
+	void* m_sq_mapping = nullptr;
+	size_t m_sq_mapping_size = 0;
+	void* m_cq_mapping = nullptr;
+	size_t m_cq_mapping_size = 0;
+	io_uring_sqe* m_sqes = nullptr;
+	size_t m_sqes_size = 0;
+	uint32_t* m_sq_head = nullptr;
+	uint32_t* m_sq_tail = nullptr;
+	uint32_t m_sq_mask = 0;
+	uint32_t m_sq_entries = 0;
+	uint32_t* m_sq_array = nullptr;
+	uint32_t* m_cq_head = nullptr;
+	uint32_t* m_cq_tail = nullptr;
+	uint32_t m_cq_mask = 0;
+	io_uring_cqe* m_cqes = nullptr;
+	bool m_multishot = false;                  // Kernel has multishot read (Linux 6.7), otherwise read is re-armed
+	bool m_skip_success = false;               // Given back buffers do not post completion (Linux 5.17)
+
+	std::mutex m_ring_lock;                    // Rings and state below
+	std::condition_variable m_progress;        // Write completed (or read thread does not collect completions now)
+	bool m_reader_waiting = false;             // Read thread sleep in io_uring_enter
+	bool m_woken = false;
+	uint32_t m_sq_pending = 0;                 // Queued entries not submitted yet
+	bool m_drain_expired = false;              // Timeout of close_write fired
+
+	// Provided buffers, kernel fill them and read thread give them back
+	std::unique_ptr<uint8_t[]> m_buffers;
+	bool m_read_armed = false;
+	platform::io_result m_read_result = platform::io_result::ok;  // End of reads (other side closed, failure)
+	completed_read m_reads[buffer_count];      // Filled buffers not parsed yet (each one hold its buffer)
+	size_t m_reads_begin = 0;
+	size_t m_reads_count = 0;
+
+	// Buffer parsed by read thread (-1 none)
+	int m_current = -1;
+	size_t m_current_size = 0;
+	size_t m_current_offset = 0;
+
+	// Send ring, bytes between tail and head wait for write, one write is in flight at most
+	std::unique_ptr<uint8_t[]> m_send_ring;
+	uint64_t m_send_head = 0;                  // Appended
+	uint64_t m_send_tail = 0;                  // Written
+	uint64_t m_send_submitted = 0;             // In flight up to
+	platform::io_result m_write_result = platform::io_result::ok;
+};
+
+} // end of namespace ipc
+
+#endif // __linux__
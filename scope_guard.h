@@ -1,31 +1,38 @@
 #pragma once
 
-#include <functional>
+#include <utility>
 
 namespace utils {
 
+// Callable is stored by value (no std::function), so guard never allocate,
+// `utils::scope_guard guard = [&]() { ... };` deduce it
+template<class Callable>
 class scope_guard {
 public:
-	template<class Callable>
-	scope_guard(Callable && undo_func) : f(std::forward<Callable>(undo_func)) {}
+	scope_guard(Callable && undo_func) : f(std::move(undo_func)) {}
+	scope_guard(const Callable & undo_func) : f(undo_func) {}
 
-	scope_guard(scope_guard && other) : f(std::move(other.f)) {
-		other.f = nullptr;
+	scope_guard(scope_guard && other) : f(std::move(other.f)), active(other.active) {
+		other.active = false;
 	}
 
 	~scope_guard() {
-		if (f) f(); // must not throw
+		if (active) f(); // must not throw
 	}
 
 	void dismiss() noexcept {
-		f = nullptr;
+		active = false;
 	}
 
 	scope_guard(const scope_guard&) = delete;
 	void operator=(const scope_guard&) = delete;
 
 private:
-	std::function<void()> f;
+	Callable f;
+	bool active = true;
 };
 
-} // end of namespace utils
\ No newline at end of file
+template<class Callable>
+scope_guard(Callable) -> scope_guard<Callable>;
+
+} // end of namespace utils
@@ -5,11 +5,15 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #include <stdio.h>
 #include <tchar.h>
 
 #include <windows.h>
+#else
+#include <stdio.h>
+#endif
 #include "spdlog/spdlog.h"
 #include "logger_holder.h"
\ No newline at end of file